@@ -0,0 +1,16 @@
+#ifndef ACCEPTANCE_H
+#define ACCEPTANCE_H
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+// Metropolis criterion: a worsening move of cost_diff is accepted with probability exp(-cost_diff / temp)
+// (shared by the simulated annealing and the ALNS)
+inline int metropolis_accept(float cost_diff, float temp, mt19937& rng) {
+    float prob = exp(-cost_diff / temp) * 100;
+    return (rng() % 100 < prob);
+}
+
+#endif
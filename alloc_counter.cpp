@@ -0,0 +1,33 @@
+#include "alloc_counter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long long> allocations(0);
+
+static void* counted_allocation( std::size_t size )
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if( void* p = std::malloc(size == 0 ? 1 : size) ) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new( std::size_t size ) { return counted_allocation(size); }
+void* operator new[]( std::size_t size ) { return counted_allocation(size); }
+void operator delete( void* p ) noexcept { std::free(p); }
+void operator delete[]( void* p ) noexcept { std::free(p); }
+void operator delete( void* p, std::size_t ) noexcept { std::free(p); }
+void operator delete[]( void* p, std::size_t ) noexcept { std::free(p); }
+
+long long allocation_count() { return allocations.load(std::memory_order_relaxed); }
+bool allocations_counted() { return true; }
+
+#else
+
+long long allocation_count() { return 0; }
+bool allocations_counted() { return false; }
+
+#endif
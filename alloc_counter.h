@@ -0,0 +1,14 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+/*
+ * Counting allocator hook. When alloc_counter.cpp is compiled with -DCOUNT_ALLOCATIONS it
+ * replaces the global operator new / delete of the program with versions that count every heap
+ * allocation (from any thread), so a loop can be checked to allocate nothing:
+ *     long long before = allocation_count();  ...loop...  allocation_count() - before
+ * Without the flag nothing is replaced and allocation_count() is always 0.
+ */
+long long allocation_count();
+bool allocations_counted();
+
+#endif
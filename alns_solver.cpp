@@ -0,0 +1,478 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include "data_loader.h"
+#include "neighborhood_generator.h"
+#include "time_lib.h"
+#include "giant_tour.h"
+#include "cost_evaluator.h"
+#include "acceptance.h"
+#include "construction.h"
+
+using namespace std;
+
+/*
+ * Adaptive Large Neighborhood Search (Ropke & Pisinger, 2006).
+ * Every iteration takes the current solution, removes q customers with a destroy operator and
+ * inserts them back with a repair operator; the routes touched by the repair are polished with
+ * 2-opt and the candidate is accepted with the same Metropolis criterion as the simulated
+ * annealing. Destroy and repair operators are drawn by roulette wheel, and their weights are
+ * adapted every segment from the scores they earned (new best, improvement, accepted).
+ */
+
+enum destroy_operator { RANDOM_REMOVAL = 0, WORST_REMOVAL = 1, SHAW_REMOVAL = 2, ROUTE_REMOVAL = 3, TOTAL_DESTROY_OPERATORS = 4 };
+enum repair_operator { GREEDY_INSERTION = 0, REGRET_2_INSERTION = 1, REGRET_3_INSERTION = 2, TOTAL_REPAIR_OPERATORS = 3 };
+
+// Largest k of the regret-k repairs (REGRET_3_INSERTION): size of the best options kept per customer
+constexpr int MAX_REGRET = 3;
+
+const char* destroy_names[] = { "random", "worst", "shaw", "route" };
+const char* repair_names[] = { "greedy", "regret-2", "regret-3" };
+
+// Scores of Ropke & Pisinger: candidate is a new best, improves the current solution, or is a worse one accepted
+const double SCORE_NEW_BEST = 33, SCORE_IMPROVED = 9, SCORE_ACCEPTED = 13;
+
+/*
+ * Roulette wheel over the operators of one kind. Scores are summed during a segment of
+ * iterations; at the end of it every used operator moves its weight towards its average score:
+ *   w = (1 - reaction) * w + reaction * score / uses
+ * With adaptive = false the weights stay equal (uniform selection).
+ */
+struct adaptive_weights
+{
+    vector<double> weights, scores;
+    vector<int> uses;
+    double reaction = 0.1;
+    bool adaptive = true;
+
+    explicit adaptive_weights( int total_operators ) : weights(total_operators, 1.0), scores(total_operators, 0), uses(total_operators, 0) {}
+
+    int select( mt19937& rng )
+    {
+        double total = accumulate(weights.begin(), weights.end(), 0.0);
+        double ticket = generate_canonical<double, 32>(rng) * total;
+        for(int op = 0; op < (int) weights.size(); ++op)
+        {
+            if( ticket < weights[op] ) return op;
+            ticket -= weights[op];
+        }
+        return (int) weights.size() - 1;
+    }
+
+    void reward( int op, double score )
+    {
+        scores[op] += score;
+        uses[op]++;
+    }
+
+    void end_segment()
+    {
+        for(int op = 0; op < (int) weights.size(); ++op)
+        {
+            if( adaptive && uses[op] > 0 ) weights[op] = max(0.05, (1 - reaction) * weights[op] + reaction * scores[op] / uses[op]);
+            scores[op] = 0;
+            uses[op] = 0;
+        }
+    }
+};
+
+// Cheapest feasible insertion of a pending customer in one route (position = -1 when it does not fit)
+struct insertion_option
+{
+    int delta, position;
+};
+
+struct alns_solver
+{
+    shared_ptr<const instance> data_inst; // shared, never copied
+    neighborhood_generator n_generator; // provides the random stream of the search
+    cost_evaluator evaluator;
+
+    vector< vector<int> > cur_routes, best_routes, candidate_routes;
+    vector<int> cur_routes_capacities, candidate_capacities;
+    int cur_route_cost, best_route_cost;
+
+    // parameters
+    int min_removal = 5, max_removal = 40; // customers removed per iteration (capped at 40% of them)
+    int segment_length = 100;              // iterations between two weight updates
+    double start_worsening = 0.05;         // a 5% worse solution is accepted with probability 1/2 at the start...
+    double final_temperature_ratio = 0.002; // ...and the temperature decays geometrically to this fraction
+    double worst_randomness = 3, shaw_randomness = 6; // y^p selection of the sorted candidates
+    int shaw_candidates = 1000;            // above this many customers, Shaw only ranks the nearest ones of the reference
+
+    adaptive_weights destroy_weights, repair_weights;
+    long long iterations_done = 0;
+    int max_distance; // diagonal of the bounding box of the points
+
+    // work buffers, kept between iterations
+    vector<int> removed;
+    vector<char> is_removed;
+    vector< pair<int, int> > ranking;
+    vector<int> nearby;
+    vector< vector<insertion_option> > options; // [pending customer][route]
+    vector<char> touched;
+
+    alns_solver( shared_ptr<const instance> ins ) : destroy_weights(TOTAL_DESTROY_OPERATORS), repair_weights(TOTAL_REPAIR_OPERATORS) {
+        data_inst = ins;
+        n_generator = neighborhood_generator(ins);
+        evaluator = cost_evaluator(ins.get());
+        is_removed.assign(data_inst->dimension, 0);
+        const spatial_index& grid = data_inst->points_index;
+        max_distance = max(1, euclidean_distance(make_pair(grid.min_x, grid.min_y), make_pair(grid.max_x, grid.max_y)));
+    }
+
+    void set_adaptive( bool adaptive ) {
+        destroy_weights.adaptive = repair_weights.adaptive = adaptive;
+    }
+
+    int should_update( float cost_diff, float temp ) {
+        return metropolis_accept(cost_diff, temp, n_generator.rng);
+    }
+
+    /*
+     * Initial solution: customers sorted by the angle they make with the depot, cut into routes
+     * by the optimal Split
+     */
+    void initial_solution() {
+        vector<int> tour;
+        sweep_constructor(data_inst.get()).rotated_tour(0, tour);
+        cur_route_cost = split_giant_tour(tour, *data_inst, cur_routes, cur_routes_capacities);
+        reserve_routes(cur_routes, *data_inst);
+    }
+
+    int removal_count() {
+        int customers = data_inst->dimension - 1;
+        int hi = max(1, min(max_removal, (int) (0.4 * customers)));
+        int lo = min(min_removal, hi);
+        return lo + (int) (n_generator.rng() % (hi - lo + 1));
+    }
+
+    void mark_removed( int customer ) {
+        if (is_removed[customer]) return;
+        is_removed[customer] = 1;
+        removed.push_back(customer);
+    }
+
+    /*
+     * Destroy operators: they only choose the customers (removed / is_removed),
+     * take_out_removed then deletes them from the routes
+     */
+    // The destroy operators share one signature; the random one does not look at the routes
+    void random_removal( const vector< vector<int> >& /* routes */, int q ) {
+        int customers = data_inst->dimension - 1;
+        while ((int) removed.size() < q) {
+            int customer = (int) (n_generator.rng() % customers);
+            if (customer >= data_inst->depot_index) customer++;
+            mark_removed(customer);
+        }
+    }
+
+    // Removes the customers whose removal saves the most, drawn with bias y^p towards the top of the ranking
+    void worst_removal( const vector< vector<int> >& routes, int q ) {
+        const distance_matrix& d = data_inst->distances;
+        ranking.clear();
+        for (const vector<int>& route : routes) {
+            for (int i = 1; i < (int) route.size(); i++) {
+                int prev = route[i - 1], next = (i + 1 < (int) route.size() ? route[i + 1] : data_inst->depot_index);
+                ranking.emplace_back(-(d.dist(prev, route[i]) + d.dist(route[i], next) - d.dist(prev, next)), route[i]);
+            }
+        }
+        sort(ranking.begin(), ranking.end());
+        while ((int) removed.size() < q && !ranking.empty()) {
+            double y = generate_canonical<double, 32>(n_generator.rng);
+            int pick = (int) (pow(y, worst_randomness) * ranking.size());
+            mark_removed(ranking[pick].second);
+            ranking.erase(ranking.begin() + pick);
+        }
+    }
+
+    // Relatedness of Shaw: close customers with similar demands (the smaller, the more related),
+    // distance and demand difference normalized by their largest values
+    int relatedness( int a, int b, int max_demand ) {
+        return 9 * 1000 * data_inst->distances.dist(a, b) / max_distance + 2 * 1000 * abs(data_inst->demands[a] - data_inst->demands[b]) / max_demand;
+    }
+
+    // Starts from a random customer and keeps removing the customers most related to an already removed one
+    void shaw_removal( const vector< vector<int> >& routes, int q ) {
+        int max_demand = max(1, *max_element(data_inst->demands.begin(), data_inst->demands.end()));
+        random_removal(routes, 1);
+        while ((int) removed.size() < q) {
+            int reference = removed[n_generator.rng() % removed.size()];
+            ranking.clear();
+            if (data_inst->dimension - 1 > shaw_candidates) {
+                // the distance term dominates the relatedness: the far customers would never be picked
+                data_inst->points_index.nearest(data_inst->points[reference], shaw_candidates, [&] (int v) {
+                    return v != data_inst->depot_index && !is_removed[v];
+                }, nearby);
+                for (const int v : nearby) ranking.emplace_back(relatedness(reference, v, max_demand), v);
+            }
+            else for (int v = 0; v < data_inst->dimension; v++)
+                if (v != data_inst->depot_index && !is_removed[v]) ranking.emplace_back(relatedness(reference, v, max_demand), v);
+            if (ranking.empty()) break;
+            sort(ranking.begin(), ranking.end());
+            double y = generate_canonical<double, 32>(n_generator.rng);
+            mark_removed(ranking[(int) (pow(y, shaw_randomness) * ranking.size())].second);
+        }
+    }
+
+    // Removes every customer of a random route, so the repair may spread them over the others
+    // (q is not used: the route decides how many customers leave)
+    void route_removal( const vector< vector<int> >& routes, int /* q */ ) {
+        const vector<int>& route = routes[n_generator.rng() % routes.size()];
+        for (int i = 1; i < (int) route.size(); i++) mark_removed(route[i]);
+    }
+
+    void take_out_removed( vector< vector<int> >& routes, vector<int>& route_capacities ) {
+        int kept = 0;
+        for (int r = 0; r < (int) routes.size(); r++) {
+            vector<int>& route = routes[r];
+            route.erase(remove_if(route.begin() + 1, route.end(), [&] (int v) { return is_removed[v] != 0; }), route.end());
+            route_capacities[r] = 0;
+            for (int v : route) route_capacities[r] += data_inst->demands[v];
+            if (route.size() > 1) {
+                if (kept != r) {
+                    swap(routes[kept], routes[r]);
+                    route_capacities[kept] = route_capacities[r];
+                }
+                kept++;
+            }
+        }
+        routes.resize(kept);
+        route_capacities.resize(kept);
+    }
+
+    /*
+     * Repair operators
+     */
+    insertion_option best_insertion( const vector<int>& route, int route_capacity, int customer ) {
+        const distance_matrix& d = data_inst->distances;
+        insertion_option best{0, -1};
+        if (route_capacity + data_inst->demands[customer] > data_inst->uniform_vehicle_capacity) return best;
+        for (int i = 1; i <= (int) route.size(); i++) {
+            int prev = route[i - 1], next = (i < (int) route.size() ? route[i] : data_inst->depot_index);
+            int delta = d.dist(prev, customer) + d.dist(customer, next) - d.dist(prev, next);
+            if (best.position < 0 || delta < best.delta) best = insertion_option{delta, i};
+        }
+        return best;
+    }
+
+    /*
+     * Inserts the removed customers one at a time. Greedy (regret = 1) takes the cheapest insertion
+     * overall; regret-k takes the customer that loses the most if it does not get its best route now,
+     * sum over j < k of (j-th best - best). Opening a new route is always an option, with cost
+     * 2 * d(depot, customer). Only the options in the route that received a customer are evaluated again.
+     */
+    void regret_insertion( vector< vector<int> >& routes, vector<int>& route_capacities, int regret ) {
+        regret = max(1, min(regret, MAX_REGRET));
+        const distance_matrix& d = data_inst->distances;
+        int pending = (int) removed.size();
+        options.resize(max((int) options.size(), pending));
+        for (int k = 0; k < pending; k++) {
+            options[k].resize(routes.size());
+            for (int r = 0; r < (int) routes.size(); r++) options[k][r] = best_insertion(routes[r], route_capacities[r], removed[k]);
+        }
+        while (pending > 0) {
+            int chosen = -1, chosen_route = -1, chosen_position = -1;
+            long long chosen_regret = -1;
+            int chosen_delta = 0;
+            for (int k = 0; k < pending; k++) {
+                int customer = removed[k];
+                // the regret best options, starting from the new route
+                int best_deltas[MAX_REGRET], best_routes_of[MAX_REGRET], found = 1;
+                best_deltas[0] = 2 * d.dist(data_inst->depot_index, customer);
+                best_routes_of[0] = -1;
+                auto offer = [&] (int delta, int route) {
+                    if (found < regret) found++;
+                    else if (delta >= best_deltas[found - 1]) return;
+                    int j = found - 1;
+                    while (j > 0 && best_deltas[j - 1] > delta) {
+                        best_deltas[j] = best_deltas[j - 1];
+                        best_routes_of[j] = best_routes_of[j - 1];
+                        j--;
+                    }
+                    best_deltas[j] = delta;
+                    best_routes_of[j] = route;
+                };
+                for (int r = 0; r < (int) routes.size(); r++)
+                    if (options[k][r].position >= 0) offer(options[k][r].delta, r);
+                long long loss = 0;
+                for (int j = 1; j < regret; j++)
+                    loss += (j < found ? best_deltas[j] : 2 * d.dist(data_inst->depot_index, customer)) - best_deltas[0];
+                bool better;
+                if (regret == 1) better = (chosen < 0 || best_deltas[0] < chosen_delta);
+                else better = (chosen < 0 || loss > chosen_regret || (loss == chosen_regret && best_deltas[0] < chosen_delta));
+                if (better) {
+                    chosen = k;
+                    chosen_regret = loss;
+                    chosen_delta = best_deltas[0];
+                    chosen_route = best_routes_of[0];
+                    chosen_position = (chosen_route >= 0 ? options[k][chosen_route].position : 1);
+                }
+            }
+            int customer = removed[chosen];
+            if (chosen_route < 0) {
+                routes.emplace_back(1, data_inst->depot_index);
+                routes.back().reserve(max_route_length(*data_inst));
+                route_capacities.push_back(0);
+                chosen_route = (int) routes.size() - 1;
+                touched.push_back(0);
+            }
+            routes[chosen_route].insert(routes[chosen_route].begin() + chosen_position, customer);
+            route_capacities[chosen_route] += data_inst->demands[customer];
+            touched[chosen_route] = 1;
+
+            // the chosen customer leaves the pending list, the others see the changed route again
+            pending--;
+            swap(removed[chosen], removed[pending]);
+            swap(options[chosen], options[pending]);
+            for (int k = 0; k < pending; k++) {
+                options[k].resize(routes.size());
+                options[k][chosen_route] = best_insertion(routes[chosen_route], route_capacities[chosen_route], removed[k]);
+            }
+        }
+    }
+
+    // 2-opt descent (segment reversal) inside one route
+    void polish_route( vector<int>& route ) {
+        const distance_matrix& d = data_inst->distances;
+        int sz = (int) route.size();
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (int i = 1; i < sz - 1 && !improved; i++) {
+                for (int j = i + 1; j < sz; j++) {
+                    int before = route[i - 1], after = (j + 1 < sz ? route[j + 1] : data_inst->depot_index);
+                    int delta = d.dist(before, route[j]) + d.dist(route[i], after) - d.dist(before, route[i]) - d.dist(route[j], after);
+                    if (delta < 0) {
+                        reverse(route.begin() + i, route.begin() + j + 1);
+                        improved = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * Runs the search from the radial Split solution for at most max_iterations iterations
+     * (and until limits is reached). Returns the best solution found.
+     */
+    vector< vector<int> > solve( long long max_iterations, search_limits limits = search_limits() ) {
+        initial_solution();
+        best_routes = cur_routes;
+        best_route_cost = cur_route_cost;
+        candidate_routes = cur_routes;
+        candidate_capacities = cur_routes_capacities;
+        reserve_routes(candidate_routes, *data_inst);
+
+        double temperature = -start_worsening * cur_route_cost / log(0.5);
+        double cooling = pow(final_temperature_ratio, 1.0 / max(1LL, max_iterations));
+
+        for (iterations_done = 0; iterations_done < max_iterations && !limits.should_stop(best_route_cost); iterations_done++) {
+            int destroy = destroy_weights.select(n_generator.rng);
+            int repair = repair_weights.select(n_generator.rng);
+
+            candidate_routes = cur_routes;
+            candidate_capacities = cur_routes_capacities;
+            removed.clear();
+            int q = removal_count();
+            if (destroy == RANDOM_REMOVAL) random_removal(candidate_routes, q);
+            else if (destroy == WORST_REMOVAL) worst_removal(candidate_routes, q);
+            else if (destroy == SHAW_REMOVAL) shaw_removal(candidate_routes, q);
+            else route_removal(candidate_routes, q);
+            take_out_removed(candidate_routes, candidate_capacities);
+
+            touched.assign(candidate_routes.size(), 0);
+            regret_insertion(candidate_routes, candidate_capacities, (repair == GREEDY_INSERTION ? 1 : repair == REGRET_2_INSERTION ? 2 : 3));
+            for (int r = 0; r < (int) candidate_routes.size(); r++)
+                if (touched[r]) polish_route(candidate_routes[r]);
+            for (int customer : removed) is_removed[customer] = 0;
+
+            int candidate_cost = evaluator.solution_cost(candidate_routes);
+            double score = 0;
+            if (candidate_cost < cur_route_cost || should_update(candidate_cost - cur_route_cost, temperature)) {
+                if (candidate_cost < best_route_cost) score = SCORE_NEW_BEST;
+                else if (candidate_cost < cur_route_cost) score = SCORE_IMPROVED;
+                else if (candidate_cost > cur_route_cost) score = SCORE_ACCEPTED;
+                swap(cur_routes, candidate_routes);
+                swap(cur_routes_capacities, candidate_capacities);
+                cur_route_cost = candidate_cost;
+                if (cur_route_cost < best_route_cost) {
+                    best_route_cost = cur_route_cost;
+                    best_routes = cur_routes;
+                }
+            }
+            destroy_weights.reward(destroy, score);
+            repair_weights.reward(repair, score);
+            if ((iterations_done + 1) % segment_length == 0) {
+                destroy_weights.end_segment();
+                repair_weights.end_segment();
+            }
+            temperature *= cooling;
+        }
+        return best_routes;
+    }
+
+    int instance_bks() {
+        const string& name = data_inst->instance_name;
+        if( name == "X-n101-k25" ) return 27591;
+        else if( name == "X-n110-k13") return 14971;
+        else if( name == "X-n115-k10") return 12747;
+        return 19565;
+    }
+};
+
+/*
+ * Usage: ./ALNS_SOLVER [--iterations N] [--time-limit ms] [--target-gap g] [--uniform] [--seed s]
+ *   --iterations   iterations of each run (default 25000)
+ *   --time-limit   wall clock limit of each run
+ *   --target-gap   stop as soon as a solution at most g (e.g. 0.05) above the BKS is found
+ *   --uniform      keeps the operator weights equal (no adaptation), for comparison
+ */
+int main(int argc, char** argv)
+{
+    long long iterations = 25000;
+    long double time_limit_ms = 0;
+    double target_gap = -1;
+    bool adaptive = true;
+    unsigned seed = 13;
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        if (arg == "--iterations" && a + 1 < argc) iterations = atoll(argv[++a]);
+        else if (arg == "--time-limit" && a + 1 < argc) time_limit_ms = atof(argv[++a]);
+        else if (arg == "--target-gap" && a + 1 < argc) target_gap = atof(argv[++a]);
+        else if (arg == "--uniform") adaptive = false;
+        else if (arg == "--seed" && a + 1 < argc) seed = (unsigned) atoll(argv[++a]);
+        else {
+            cerr << "Invalid option: " << arg << endl;
+            cerr << "Usage: ./ALNS_SOLVER [--iterations N] [--time-limit ms] [--target-gap g] [--uniform] [--seed s]" << endl;
+            return 1;
+        }
+    }
+    vector<string> instances = {"instances/X-n101-k25.vrp", "instances/X-n110-k13.vrp", "instances/X-n115-k10.vrp", "instances/X-n204-k19.vrp"};
+    for (const string& file : instances) {
+        alns_solver solver(load_shared_instance(file));
+        solver.n_generator.set_seed(seed);
+        solver.set_adaptive(adaptive);
+        int bks = solver.instance_bks();
+        search_limits limits(time_limit_ms, (target_gap >= 0 ? search_limits::target_from_gap(bks, target_gap) : -1), 16);
+        wall_timer timer;
+        solver.solve(iterations, limits);
+        long double duration = timer.elapsed_ms();
+
+        cout << solver.data_inst->instance_name << ": " << solver.best_route_cost << " em " << duration << " ms (" << solver.iterations_done << " iteracoes)" << endl;
+        cout << "  pesos destroy:";
+        for (int op = 0; op < TOTAL_DESTROY_OPERATORS; op++) cout << " " << destroy_names[op] << "=" << solver.destroy_weights.weights[op];
+        cout << endl << "  pesos repair:";
+        for (int op = 0; op < TOTAL_REPAIR_OPERATORS; op++) cout << " " << repair_names[op] << "=" << solver.repair_weights.weights[op];
+        cout << endl;
+
+        ofstream out("alns_results/" + solver.data_inst->instance_name + (adaptive ? "" : "_uniform") + ".csv");
+        out << "Iteracoes,Tempo (ms),Solucao,BKS,Approximation Ratio" << endl;
+        out << solver.iterations_done << "," << duration << "," << solver.best_route_cost << "," << bks << "," << 1.0 * solver.best_route_cost / bks << endl;
+        out.close();
+    }
+}
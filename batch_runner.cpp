@@ -0,0 +1,63 @@
+#include "batch_runner.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+
+batch_config read_batch_config( const string& path )
+{
+    batch_config config;
+    ifstream in(path);
+    if( !in )
+    {
+        cerr << "Nao foi possivel abrir " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+    string line;
+    while( getline(in, line) )
+    {
+        line = line.substr(0, line.find('#'));
+        stringstream sl(line);
+        string key;
+        if( !(sl >> key) ) continue;
+        if( key == "instance" )
+        {
+            string instance_path;
+            int bks = 0;
+            sl >> instance_path >> bks;
+            config.instances.push_back(instance_path);
+            config.bks.push_back(bks);
+        }
+        else if( key == "iterations" ) { int v; while( sl >> v ) config.iterations.push_back(v); }
+        else if( key == "temperatures" ) { int v; while( sl >> v ) config.temperatures.push_back(v); }
+        else if( key == "factors" ) { float v; while( sl >> v ) config.factors.push_back(v); }
+        else if( key == "jobs" ) sl >> config.jobs;
+        else if( key == "time_budget_ms" ) sl >> config.time_budget_ms;
+        else if( key == "target_gap" ) sl >> config.target_gap;
+        else if( key == "output_dir" ) sl >> config.output_dir;
+        else cerr << path << ": chave desconhecida '" << key << "'" << endl;
+    }
+    return config;
+}
+
+string instance_basename( const string& path )
+{
+    string name = path.substr( path.find_last_of('/') + 1 );
+    return name.substr( 0, name.find_last_of('.') );
+}
+
+void run_jobs( const vector< function<void()> >& jobs, int max_concurrent )
+{
+    if( max_concurrent <= 0 ) max_concurrent = max(1u, thread::hardware_concurrency());
+    int workers = min( max_concurrent, (int) jobs.size() );
+    atomic<int> next_job(0);
+    auto worker = [&] ()
+    {
+        for(int j = next_job++; j < (int) jobs.size(); j = next_job++) jobs[j]();
+    };
+    vector< thread > pool;
+    for(int w = 0; w < workers; ++w) pool.emplace_back(worker);
+    for(auto& t : pool) t.join();
+}
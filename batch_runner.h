@@ -0,0 +1,45 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+/*
+ * Experiment grid read from a config file. One keyword per line followed by its values,
+ * '#' starts a comment:
+ *
+ *   instance instances/X-n101-k25.vrp 27591     (path and BKS, one line per instance)
+ *   iterations 5 10 50                          (GRASP restarts)
+ *   temperatures 10000 5000                     (SA initial temperatures)
+ *   factors 0.85 0.9                            (SA temperature factors)
+ *   jobs 8                                      (cells running at the same time, 0 = one per core)
+ *   time_budget_ms 60000                        (wall clock limit of each cell, 0 = none)
+ *   target_gap 0.05                             (stop a cell 5% above the BKS, omitted = no target)
+ *   output_dir grasp_results/                   (where the per instance CSVs are written)
+ */
+struct batch_config
+{
+    vector< string > instances;
+    vector< int > bks;
+    vector< int > iterations;
+    vector< int > temperatures;
+    vector< float > factors;
+    int jobs = 0;
+    long double time_budget_ms = 0;
+    double target_gap = -1;
+    string output_dir;
+};
+
+batch_config read_batch_config( const string& path );
+
+// Name of the instance file without directory and extension, used to name the CSVs
+string instance_basename( const string& path );
+
+// Runs every job, at most max_concurrent at a time (0 = number of cores), and waits for all of them
+void run_jobs( const vector< function<void()> >& jobs, int max_concurrent );
+
+#endif
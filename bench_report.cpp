@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include "bench_report.h"
+
+// Linear interpolation between the closest ranks of a sorted sample
+static double percentile( const vector<double>& sorted, double q )
+{
+    if( sorted.empty() ) return 0;
+    double position = q * (sorted.size() - 1);
+    size_t below = (size_t) position;
+    if( below + 1 >= sorted.size() ) return sorted.back();
+    double fraction = position - below;
+    return sorted[below] * (1 - fraction) + sorted[below + 1] * fraction;
+}
+
+sample_summary summarize( vector<double> samples )
+{
+    sample_summary summary;
+    if( samples.empty() ) return summary;
+    sort( samples.begin(), samples.end() );
+    summary.samples = (int) samples.size();
+    summary.mean = accumulate( samples.begin(), samples.end(), 0.0 ) / samples.size();
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.p10 = percentile( samples, 0.10 );
+    summary.median = percentile( samples, 0.50 );
+    summary.p90 = percentile( samples, 0.90 );
+    summary.p99 = percentile( samples, 0.99 );
+    return summary;
+}
+
+void bench_report::add( const bench_record& record )
+{
+    records.push_back( record );
+    const sample_summary& s = record.stats;
+    printf("%-12s %-28s %-16s %5d %12.1f %12.1f %12.1f %12.1f %-3s %12.1f", record.suite.c_str(), record.name.c_str(), record.instance.c_str(),
+           s.samples, s.p10, s.median, s.p90, s.p99, record.unit.c_str(), record.per_second);
+    if( record.success_rate >= 0 ) printf(" %5.0f%%", 100 * record.success_rate);
+    printf("\n");
+}
+
+bool bench_report::write_json( const string& path ) const
+{
+    FILE* out = fopen( path.c_str(), "w" );
+    if( out == nullptr )
+    {
+        cerr << "Nao foi possivel escrever " << path << endl;
+        return false;
+    }
+    fprintf(out, "{\n  \"seed\": %u,\n  \"records\": [", seed);
+    for(size_t r = 0; r < records.size(); ++r)
+    {
+        const bench_record& record = records[r];
+        const sample_summary& s = record.stats;
+        fprintf(out, "%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"instance\": \"%s\", \"unit\": \"%s\", \"samples\": %d, "
+                     "\"mean\": %.3f, \"min\": %.3f, \"p10\": %.3f, \"median\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, "
+                     "\"per_second\": %.3f, \"success_rate\": %.3f}",
+                (r == 0 ? "" : ","), record.suite.c_str(), record.name.c_str(), record.instance.c_str(), record.unit.c_str(), s.samples,
+                s.mean, s.min, s.p10, s.median, s.p90, s.p99, s.max, record.per_second, record.success_rate);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+    return true;
+}
+
+bool bench_report::write_csv( const string& path ) const
+{
+    FILE* out = fopen( path.c_str(), "w" );
+    if( out == nullptr )
+    {
+        cerr << "Nao foi possivel escrever " << path << endl;
+        return false;
+    }
+    fprintf(out, "seed,suite,name,instance,unit,samples,mean,min,p10,median,p90,p99,max,per_second,success_rate\n");
+    for(const bench_record& record : records)
+    {
+        const sample_summary& s = record.stats;
+        fprintf(out, "%u,%s,%s,%s,%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", seed, record.suite.c_str(), record.name.c_str(), record.instance.c_str(),
+                record.unit.c_str(), s.samples, s.mean, s.min, s.p10, s.median, s.p90, s.p99, s.max, record.per_second, record.success_rate);
+    }
+    fclose(out);
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Distribution of the samples of one measurement (percentiles interpolate between samples)
+struct sample_summary
+{
+    int samples = 0;
+    double mean = 0, min = 0, p10 = 0, median = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+sample_summary summarize( vector<double> samples );
+
+/*
+ * One line of a benchmark report: what was measured (suite, name, instance), the summary of its
+ * samples in `unit`, the throughput (operations per second at the median) and, for time to target
+ * runs, the fraction of runs that reached the target (-1 when it does not apply).
+ */
+struct bench_record
+{
+    string suite, name, instance, unit;
+    sample_summary stats;
+    double per_second = 0;
+    double success_rate = -1;
+};
+
+/*
+ * Records of one BENCHMARK run, printed as a table while they are added and written as JSON
+ * and/or CSV at the end, so runs can be compared by a script (the CI keeps the previous files).
+ * Both files carry the seed of the run, so it can be repeated exactly.
+ */
+struct bench_report
+{
+    unsigned seed = 0;
+    vector<bench_record> records;
+
+    void add( const bench_record& record );
+    // Returns false (and prints why) if the file cannot be written
+    bool write_json( const string& path ) const;
+    bool write_csv( const string& path ) const;
+};
+
+#endif
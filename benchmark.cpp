@@ -0,0 +1,1113 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <tuple>
+#include <algorithm>
+#include "data_loader.h"
+#include "neighborhood_generator.h"
+#include "flat_solution.h"
+#include "gain_kernel.h"
+#include "cost_evaluator.h"
+#include "construction.h"
+#include "giant_tour.h"
+#include "bench_report.h"
+#include "time_lib.h"
+#include "solution_hash.h"
+#include "route_bounds.h"
+
+using namespace std;
+
+/*
+ * Benchmarks for the building blocks of the solvers.
+ * Usage: ./BENCHMARK [granular|distances|sharing|loader|flat|cache|kernel|cost|sweep|savings|hashing|pruning|spatial]   (no argument runs everything)
+ *        ./BENCHMARK [operators|construction|ttt|report] [--json file] [--csv file] [--seed s]
+ *                    [--samples n] [--runs n] [--target-gap g] [--time-limit ms]
+ * The last four are the regression suites: every measurement is repeated, summarized by its
+ * median and percentiles and written to the JSON/CSV files (report runs the three of them).
+ * Any other mode or option prints this usage and exits with status 1.
+ */
+
+const vector<string> bench_instances = { "instances/X-n101-k25.vrp", "instances/X-n110-k13.vrp", "instances/X-n115-k10.vrp", "instances/X-n204-k19.vrp" };
+
+// The timed loops add their results here, so the compiler cannot drop the calls
+volatile long long benchmark_sink = 0;
+
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Deterministic first-fit solution, so every configuration starts from the same routes
+void first_fit_solution(const instance& inst, vector< vector<int> >& routes, vector<int>& capacities)
+{
+    routes.assign(1, vector<int>(1, inst.depot_index));
+    capacities.assign(1, 0);
+    for(int v = 0; v < inst.dimension; ++v)
+    {
+        if( v == inst.depot_index ) continue;
+        if( capacities.back() + inst.demands[v] > inst.uniform_vehicle_capacity )
+        {
+            routes.emplace_back(1, inst.depot_index);
+            capacities.push_back(0);
+        }
+        routes.back().push_back(v);
+        capacities.back() += inst.demands[v];
+    }
+}
+
+int total_cost(const instance& inst, const vector< vector<int> >& routes)
+{
+    int cost = 0;
+    for(const auto& route : routes)
+    {
+        for(int i = 1; i < (int) route.size(); ++i) cost += inst.distances.dist(route[i - 1], route[i]);
+        cost += inst.distances.dist(route.back(), inst.depot_index);
+    }
+    return cost;
+}
+
+/*
+ * Runs a descent that alternates best delete_and_insert and best exchange until neither improves,
+ * once with the full O(n^2) scans and once for every granular neighbor list size.
+ */
+void bench_granular()
+{
+    vector<int> list_sizes = { 0, 5, 10, 20 };
+    printf("%-12s %-8s %8s %12s %12s %10s %8s\n", "instance", "k", "scans", "total(ms)", "per scan(ms)", "cost", "speedup");
+    for(const string& path : bench_instances)
+    {
+        instance inst(path);
+        double full_per_scan = 0;
+        for(int k : list_sizes)
+        {
+            vector< vector<int> > routes;
+            vector<int> capacities;
+            first_fit_solution(inst, routes, capacities);
+            int scans = 0, failures = 0, turn = 0;
+            auto start = chrono::steady_clock::now();
+            city_locations locations;
+            if( k > 0 ) locations.locate(routes, inst.dimension);
+            while( failures < 2 )
+            {
+                bool improved;
+                if( k == 0 ) improved = (turn == 0 ? apply_best_delete_and_insert(routes, capacities, inst) : apply_best_exchange(routes, capacities, inst));
+                else improved = (turn == 0 ? apply_best_delete_and_insert_granular(routes, capacities, inst, k, locations) : apply_best_exchange_granular(routes, capacities, inst, k, locations));
+                scans++;
+                failures = (improved ? 0 : failures + 1);
+                turn ^= 1;
+            }
+            double total = elapsed_ms(start);
+            double per_scan = total / scans;
+            if( k == 0 ) full_per_scan = per_scan;
+            string label = (k == 0 ? string("full") : to_string(k));
+            printf("%-12s %-8s %8d %12.2f %12.4f %10d %7.1fx\n", inst.instance_name.c_str(), label.c_str(), scans, total, per_scan, total_cost(inst, routes), full_per_scan / per_scan);
+        }
+    }
+}
+
+/*
+ * Compares the storage modes of distance_matrix: memory used and average time of a lookup,
+ * both walking a row (as the operators do along a route) and at random pairs.
+ */
+void bench_distances()
+{
+    const int lookups = 20000000;
+    printf("%-12s %-11s %12s %14s %14s\n", "instance", "mode", "bytes", "row(ns/op)", "random(ns/op)");
+    for(const string& path : bench_instances)
+    {
+        instance inst(path);
+        vector<int> pairs(2 * 4096);
+        for(int& v : pairs) v = rand() % inst.dimension;
+        for(auto mode : { distance_matrix::DENSE, distance_matrix::TRIANGULAR, distance_matrix::LAZY })
+        {
+            distance_matrix d;
+            d.build(inst.points, mode);
+            long long checksum = 0;
+            auto start = chrono::steady_clock::now();
+            for(int op = 0; op < lookups; ++op) checksum += d.dist(op / inst.dimension % inst.dimension, op % inst.dimension);
+            double row = elapsed_ms(start) * 1e6 / lookups;
+            start = chrono::steady_clock::now();
+            for(int op = 0; op < lookups; ++op) checksum += d.dist(pairs[(2 * op) & 8191], pairs[(2 * op + 1) & 8191]);
+            double random = elapsed_ms(start) * 1e6 / lookups;
+            benchmark_sink += checksum;
+            printf("%-12s %-11s %12zu %14.2f %14.2f\n", inst.instance_name.c_str(), d.mode_name(), d.memory_usage(), row, random);
+        }
+    }
+}
+
+// Operators as they were called before the instance was shared: every call received a deep copy of it
+__attribute__((noinline)) int route_cost_by_value(vector<int> route, instance data_inst) { return route_cost(route, data_inst); }
+__attribute__((noinline)) bool best_exchange_by_value(vector< vector<int> >& routes, vector<int>& capacities, instance data_inst) { return apply_best_exchange(routes, capacities, data_inst); }
+__attribute__((noinline)) bool best_delete_and_insert_by_value(vector< vector<int> >& routes, vector<int>& capacities, instance data_inst) { return apply_best_delete_and_insert(routes, capacities, data_inst); }
+
+/*
+ * Per call cost of the operators with the instance copied on every call (before) and
+ * with the shared instance (after). The solution is a local optimum, so the scans do not change it.
+ */
+void bench_instance_sharing()
+{
+    shared_ptr<const instance> inst = load_shared_instance("instances/X-n204-k19.vrp");
+    vector< vector<int> > routes;
+    vector<int> capacities;
+    first_fit_solution(*inst, routes, capacities);
+    while( apply_best_delete_and_insert(routes, capacities, *inst) || apply_best_exchange(routes, capacities, *inst) );
+
+    auto per_call_us = [&] (int calls, const function<void()>& op)
+    {
+        auto start = chrono::steady_clock::now();
+        for(int c = 0; c < calls; ++c) op();
+        return elapsed_ms(start) * 1000.0 / calls;
+    };
+    long long sink = 0;
+    double rc_before = per_call_us(20000, [&] { sink += route_cost_by_value(routes[0], *inst); });
+    double rc_after = per_call_us(20000, [&] { sink += route_cost(routes[0], *inst); });
+    double ex_before = per_call_us(500, [&] { sink += best_exchange_by_value(routes, capacities, *inst); });
+    double ex_after = per_call_us(500, [&] { sink += apply_best_exchange(routes, capacities, *inst); });
+    double di_before = per_call_us(500, [&] { sink += best_delete_and_insert_by_value(routes, capacities, *inst); });
+    double di_after = per_call_us(500, [&] { sink += apply_best_delete_and_insert(routes, capacities, *inst); });
+    benchmark_sink += sink;
+
+    printf("%s (%s distances, %zu bytes)\n", inst->instance_name.c_str(), inst->distances.mode_name(), inst->distances.memory_usage());
+    printf("%-30s %14s %14s\n", "operator", "before(us)", "after(us)");
+    printf("%-30s %14.3f %14.3f\n", "route_cost", rc_before, rc_after);
+    printf("%-30s %14.3f %14.3f\n", "apply_best_exchange", ex_before, ex_after);
+    printf("%-30s %14.3f %14.3f\n", "apply_best_delete_and_insert", di_before, di_after);
+    printf("solvers sharing the instance: %s\n", (load_shared_instance("instances/X-n204-k19.vrp") == inst ? "yes" : "no"));
+}
+
+// Writes a random X-like instance with the standard header layout, so both parsers can read it
+string write_synthetic_instance(int dimension)
+{
+    string path = "/tmp/cvrp_bench_n" + to_string(dimension) + ".vrp";
+    srand(dimension); // same file on every run and in every mode
+    FILE* out = fopen(path.c_str(), "w");
+    fprintf(out, "NAME : \tsynthetic-n%d\t\nCOMMENT : \t\"benchmark\"\t\nTYPE : \tCVRP\t\nDIMENSION : \t%d\t\n", dimension, dimension);
+    fprintf(out, "EDGE_WEIGHT_TYPE : \tEUC_2D\t\nCAPACITY : \t%d\t\nNODE_COORD_SECTION\t\t\n", 1000);
+    for(int v = 1; v <= dimension; ++v) fprintf(out, "%d\t%d\t%d\n", v, rand() % 100000, rand() % 100000);
+    fprintf(out, "DEMAND_SECTION\t\t\n");
+    for(int v = 1; v <= dimension; ++v) fprintf(out, "%d\t%d\t\n", v, (v == 1 ? 0 : 1 + rand() % 100));
+    fprintf(out, "DEPOT_SECTION\t\t\n\t1\t\n\t-1\t\nEOF\t\t\n");
+    fclose(out);
+    return path;
+}
+
+/*
+ * Time to parse an instance file (distances and neighbor lists excluded) with the original
+ * line based loader and with the memory-mapped one. Synthetic files cover X-n1001 and Belgium sizes.
+ */
+void bench_loader()
+{
+    vector<string> paths = bench_instances;
+    for(int dimension : { 1001, 10001, 30001 }) paths.push_back(write_synthetic_instance(dimension));
+    printf("%-14s %8s %14s %14s %8s %6s\n", "instance", "n", "legacy(ms)", "mmap(ms)", "speedup", "same");
+    for(const string& path : paths)
+    {
+        instance legacy, mapped;
+        int repetitions = 0;
+        auto start = chrono::steady_clock::now();
+        do { legacy.parse_file_legacy(path); repetitions++; } while( elapsed_ms(start) < 200 );
+        double legacy_ms = elapsed_ms(start) / repetitions;
+        repetitions = 0;
+        start = chrono::steady_clock::now();
+        do { mapped.parse_file(path); repetitions++; } while( elapsed_ms(start) < 200 );
+        double mapped_ms = elapsed_ms(start) / repetitions;
+        bool same = legacy.points == mapped.points && legacy.demands == mapped.demands && legacy.dimension == mapped.dimension
+                    && legacy.depot_index == mapped.depot_index && legacy.uniform_vehicle_capacity == mapped.uniform_vehicle_capacity
+                    && legacy.instance_name == mapped.instance_name;
+        printf("%-14s %8d %14.3f %14.3f %7.1fx %6s\n", mapped.instance_name.c_str(), mapped.dimension, legacy_ms, mapped_ms, legacy_ms / mapped_ms, (same ? "yes" : "NO"));
+    }
+}
+
+// Row and position of a customer in the nested format: a scan, since nothing indexes it
+pair<int, int> find_customer(const vector< vector<int> >& routes, int customer)
+{
+    for(int r = 0; r < (int) routes.size(); ++r)
+        for(int i = 1; i < (int) routes[r].size(); ++i)
+            if( routes[r][i] == customer ) return make_pair(r, i);
+    return make_pair(-1, -1);
+}
+
+/*
+ * Commits the same random sequence of relocates ("c right after t") and exchanges on the
+ * nested vectors (locate by scan, erase / insert) and on flat_solution (O(1) relinking).
+ * Capacities are ignored, only the cost of a commit is measured.
+ */
+void bench_flat_solution()
+{
+    const int operations = 200000;
+    printf("%-12s %14s %14s %8s %6s\n", "instance", "nested(ns/op)", "flat(ns/op)", "speedup", "same");
+    for(const string& path : bench_instances)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        vector<int> customers;
+        for(int v = 0; v < inst->dimension; ++v) if( v != inst->depot_index ) customers.push_back(v);
+        vector< pair<int, int> > ops; // (c, t): relocate when t >= 0, exchange with ~t otherwise
+        mt19937 rng(1);
+        while( (int) ops.size() < operations )
+        {
+            int c = customers[rng() % customers.size()], t = customers[rng() % customers.size()];
+            if( c != t ) ops.emplace_back(c, (rng() % 2 ? t : ~t));
+        }
+
+        vector< vector<int> > nested;
+        vector<int> capacities;
+        first_fit_solution(*inst, nested, capacities);
+        flat_solution flat(inst);
+        flat.from_routes(nested);
+
+        auto start = chrono::steady_clock::now();
+        for(const auto& op : ops)
+        {
+            pair<int, int> c = find_customer(nested, op.first);
+            if( op.second >= 0 )
+            {
+                nested[c.first].erase(nested[c.first].begin() + c.second);
+                pair<int, int> t = find_customer(nested, op.second);
+                nested[t.first].insert(nested[t.first].begin() + t.second + 1, op.first);
+            }
+            else
+            {
+                pair<int, int> t = find_customer(nested, ~op.second);
+                swap(nested[c.first][c.second], nested[t.first][t.second]);
+            }
+        }
+        double nested_ns = elapsed_ms(start) * 1e6 / operations;
+
+        start = chrono::steady_clock::now();
+        for(const auto& op : ops)
+        {
+            if( op.second >= 0 ) flat.relocate(op.first, flat.route_of[op.second], op.second);
+            else flat.exchange(op.first, ~op.second);
+        }
+        double flat_ns = elapsed_ms(start) * 1e6 / operations;
+
+        printf("%-12s %14.1f %14.1f %7.1fx %6s\n", inst->instance_name.c_str(), nested_ns, flat_ns, nested_ns / flat_ns, (total_cost(*inst, nested) == flat.total_cost ? "yes" : "NO"));
+    }
+}
+
+/*
+ * Best improvement descent as run by GRASP (random neighborhood each step, stops after 10 steps
+ * without improvement), rescanning every pair of routes vs taking the moves from move_cache.
+ * Both take the same moves, so the final costs must match. Times are averaged over 20 runs up to n = 500.
+ */
+void bench_move_cache()
+{
+    vector<string> paths = bench_instances;
+    paths.push_back(write_synthetic_instance(501));
+    paths.push_back(write_synthetic_instance(1001));
+    printf("%-16s %8s %8s %12s %12s %8s %10s %6s\n", "instance", "n", "moves", "rescan(ms)", "cached(ms)", "speedup", "cost", "same");
+    for(const string& path : paths)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        int costs[2], moves = 0;
+        double times[2] = { 0, 0 };
+        const int repeats = ( inst->dimension > 500 ? 1 : 20 );
+        for(int r = 0; r < repeats; ++r)
+        for(int cached = 0; cached < 2; ++cached)
+        {
+            vector< vector<int> > routes;
+            vector<int> capacities;
+            first_fit_solution(*inst, routes, capacities);
+            neighborhood_generator generator(inst);
+            generator.set_seed(13);
+            move_cache cache;
+            auto start = chrono::steady_clock::now();
+            if( cached ) cache.rebuild(routes, capacities, *inst);
+            int stall = 0;
+            moves = 0;
+            while( stall < 10 )
+            {
+                bool improved = ( cached ? generator.update_solution_best_improvement(routes, capacities, cache) : generator.update_solution_best_improvement(routes, capacities) );
+                stall = ( improved ? 0 : stall + 1 );
+                moves += improved;
+            }
+            times[cached] += elapsed_ms(start) / repeats;
+            costs[cached] = total_cost(*inst, routes);
+        }
+        printf("%-16s %8d %8d %12.1f %12.1f %7.1fx %10d %6s\n", inst->instance_name.c_str(), inst->dimension, moves, times[0], times[1], times[0] / times[1], costs[1], (costs[0] == costs[1] ? "yes" : "NO"));
+    }
+}
+
+/*
+ * Gain kernels: every customer scored against all positions of the first-fit solution by the
+ * scalar and by the AVX2 kernel (ns per position, results must agree), then whole best exchange
+ * and best delete_and_insert scans with the original loops and with each kernel.
+ */
+void bench_gain_kernel()
+{
+    vector<gain_kernel_isa> kernels = { KERNEL_OFF, KERNEL_SCALAR };
+    bool avx2 = set_gain_kernel(KERNEL_AVX2);
+    if( avx2 ) kernels.push_back(KERNEL_AVX2);
+    printf("%-12s %-10s %14s %16s %14s %14s %6s\n", "instance", "kernel", "insert(ns/pos)", "exchange(ns/pos)", "relocate(us)", "exchange(us)", "same");
+    for(const string& path : bench_instances)
+    {
+        instance inst(path);
+        vector< vector<int> > routes;
+        vector<int> capacities;
+        first_fit_solution(inst, routes, capacities);
+        route_block block;
+        block.load_routes(routes, capacities, inst);
+        int positions = block.begin[routes.size()];
+        long long reference_checksum = 0;
+        int reference_cost = 0;
+        for(gain_kernel_isa kernel : kernels)
+        {
+            set_gain_kernel(kernel);
+            double insert_ns = 0, exchange_ns = 0;
+            long long checksum = 0;
+            if( kernel != KERNEL_OFF )
+            {
+                // every customer scored against the whole solution, as in the full scans
+                const int rounds = 200;
+                long long scored = (long long) rounds * (inst.dimension - 1) * (positions - 1);
+                auto start = chrono::steady_clock::now();
+                for(int round = 0; round < rounds; ++round)
+                    for(int c = 1; c < inst.dimension; ++c)
+                    {
+                        int index;
+                        checksum += best_insertion_gain(block, 1, positions, inst.distances.row(c), inst.uniform_vehicle_capacity - inst.demands[c], index) + index;
+                    }
+                insert_ns = elapsed_ms(start) * 1e6 / scored;
+                start = chrono::steady_clock::now();
+                for(int round = 0; round < rounds; ++round)
+                    for(int c = 1; c < inst.dimension; ++c)
+                    {
+                        int index;
+                        checksum += best_exchange_gain(block, 1, positions, inst.distances.row(c - 1), inst.distances.row((c + 1) % inst.dimension), inst.distances.row(c),
+                                                       inst.demands[c] + 10, inst.uniform_vehicle_capacity - inst.demands[c], index) + index;
+                    }
+                exchange_ns = elapsed_ms(start) * 1e6 / scored;
+                if( kernel == KERNEL_SCALAR ) reference_checksum = checksum;
+            }
+            const int scans = 50;
+            int cost = 0;
+            auto start = chrono::steady_clock::now();
+            for(int scan = 0; scan < scans; ++scan)
+            {
+                vector< vector<int> > copy = routes;
+                vector<int> copy_capacities = capacities;
+                apply_best_delete_and_insert(copy, copy_capacities, inst);
+                cost += total_cost(inst, copy);
+            }
+            double relocate_us = elapsed_ms(start) * 1000 / scans;
+            start = chrono::steady_clock::now();
+            for(int scan = 0; scan < scans; ++scan)
+            {
+                vector< vector<int> > copy = routes;
+                vector<int> copy_capacities = capacities;
+                apply_best_exchange(copy, copy_capacities, inst);
+                cost += total_cost(inst, copy);
+            }
+            double exchange_us = elapsed_ms(start) * 1000 / scans;
+            if( kernel == KERNEL_OFF ) reference_cost = cost;
+            bool same = cost == reference_cost && (kernel == KERNEL_OFF || checksum == reference_checksum);
+            printf("%-12s %-10s %14.2f %16.2f %14.1f %14.1f %6s\n", inst.instance_name.c_str(), gain_kernel_name(kernel), insert_ns, exchange_ns, relocate_us, exchange_us, (same ? "yes" : "NO"));
+        }
+    }
+    set_gain_kernel(avx2 ? KERNEL_AVX2 : KERNEL_SCALAR);
+}
+
+// Cost as grasp_solver computed it before the cost_evaluator: ceil(sqrt) for every edge
+int euclidean_solution_cost(const instance& inst, const vector< vector<int> >& routes)
+{
+    int cost = 0;
+    for(const auto& route : routes)
+    {
+        for(int i = 1; i < (int) route.size(); ++i) cost += euclidean_distance(inst.points[route[i]], inst.points[route[i - 1]]);
+        cost += euclidean_distance(inst.points[inst.depot_index], inst.points[route.back()]);
+    }
+    return cost;
+}
+
+/*
+ * Solution cost after every improving move of a best improvement descent (what GRASP evaluates):
+ * euclidean distances recomputed, every route summed from the matrix, and the cost_evaluator,
+ * which only sums the routes changed by the move.
+ */
+void bench_cost_evaluator()
+{
+    vector<string> paths = bench_instances;
+    paths.push_back(write_synthetic_instance(1001));
+    printf("%-16s %8s %8s %16s %14s %14s %10s %6s\n", "instance", "n", "moves", "euclidean(us)", "matrix(us)", "cached(us)", "summed", "same");
+    for(const string& path : paths)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        vector< vector<int> > routes;
+        vector<int> capacities;
+        first_fit_solution(*inst, routes, capacities);
+        neighborhood_generator generator(inst);
+        generator.set_seed(13);
+        move_cache cache;
+        cache.rebuild(routes, capacities, *inst);
+        vector< vector< vector<int> > > descent(1, routes);
+        int stall = 0;
+        while( stall < 10 )
+        {
+            bool improved = generator.update_solution_best_improvement(routes, capacities, cache);
+            stall = ( improved ? 0 : stall + 1 );
+            if( improved ) descent.push_back(routes);
+        }
+
+        long long sums[3] = { 0, 0, 0 };
+        double times[3];
+        cost_evaluator evaluator(inst.get());
+        for(int method = 0; method < 3; ++method)
+        {
+            auto start = chrono::steady_clock::now();
+            for(const auto& solution : descent)
+            {
+                if( method == 0 ) sums[0] += euclidean_solution_cost(*inst, solution);
+                else if( method == 1 ) for(const auto& route : solution) sums[1] += route_cost(route, *inst);
+                else sums[2] += evaluator.solution_cost(solution);
+            }
+            times[method] = elapsed_ms(start) * 1000 / descent.size();
+        }
+        double summed = 100.0 * evaluator.summed_routes / (evaluator.summed_routes + evaluator.reused_routes);
+        bool same = sums[0] == sums[1] && sums[1] == sums[2];
+        printf("%-16s %8d %8zu %16.2f %14.2f %14.2f %9.1f%% %6s\n", inst->instance_name.c_str(), inst->dimension, descent.size() - 1, times[0], times[1], times[2], summed, (same ? "yes" : "NO"));
+    }
+}
+
+// smart_greedy as the solvers ran it on every restart before the sweep_constructor: copy the
+// points, sort them by angle, rotate, then fill the routes
+int sorted_smart_greedy(const instance& inst, int rot, vector< vector<int> >& routes)
+{
+    vector< tuple<int, int, int> > points;
+    pair<int, int> center = inst.points[inst.depot_index];
+    for(int p = 0; p < inst.dimension; ++p)
+        if( p != inst.depot_index ) points.emplace_back( inst.points[p].first, inst.points[p].second, p );
+    sort( points.begin(), points.end(), [&] (tuple<int, int, int>& a, tuple<int, int, int>& b)
+    {
+        pair<int, int> pa = make_pair(get<0>(a) - center.first, get<1>(a) - center.second);
+        pair<int, int> pb = make_pair(get<0>(b) - center.first, get<1>(b) - center.second);
+        int cross_product = pa.first * pb.second - pa.second * pb.first;
+        if( cross_product != 0 ) return (cross_product > 0);
+        return pa.first * pa.first + pa.second * pa.second < pb.first * pb.first + pb.second * pb.second;
+    });
+    rotate(points.begin(), points.begin() + rot, points.end());
+    routes.assign(1, vector<int>(1, inst.depot_index));
+    int load = 0;
+    for(const auto& P : points)
+    {
+        int customer = get<2>(P);
+        if( load + inst.demands[customer] > inst.uniform_vehicle_capacity )
+        {
+            routes.push_back(vector<int>(1, inst.depot_index));
+            load = 0;
+        }
+        routes.back().push_back(customer);
+        load += inst.demands[customer];
+    }
+    return total_cost(inst, routes);
+}
+
+/*
+ * One construction per GRASP restart: sorting the customers every time, against the rotation of
+ * the polar order computed once, and the randomized sweep (RCL of 8 candidates, alpha = 0.3)
+ */
+void bench_sweep()
+{
+    vector<string> paths = bench_instances;
+    paths.push_back(write_synthetic_instance(1001));
+    paths.push_back(write_synthetic_instance(10001));
+    printf("%-16s %8s %14s %14s %14s %6s\n", "instance", "n", "sorted(us)", "rotated(us)", "rcl(us)", "same");
+    for(const string& path : paths)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        sweep_constructor sweep(inst.get());
+        const int restarts = ( inst->dimension > 5000 ? 50 : 500 );
+        vector< vector<int> > routes;
+        vector<int> capacities, tour;
+        long long sorted_sum = 0, rotated_sum = 0, rcl_sum = 0;
+
+        auto start = chrono::steady_clock::now();
+        for(int r = 0; r < restarts; ++r) sorted_sum += sorted_smart_greedy(*inst, r % (inst->dimension - 1), routes);
+        double sorted_us = elapsed_ms(start) * 1000 / restarts;
+
+        start = chrono::steady_clock::now();
+        for(int r = 0; r < restarts; ++r)
+        {
+            sweep.rotated_tour(r, tour);
+            rotated_sum += sweep.sweep_routes(tour, routes, capacities);
+        }
+        double rotated_us = elapsed_ms(start) * 1000 / restarts;
+
+        mt19937 rng(13);
+        start = chrono::steady_clock::now();
+        for(int r = 0; r < restarts; ++r) rcl_sum += sweep.randomized_sweep(r, 0.3, 8, rng, routes, capacities);
+        double rcl_us = elapsed_ms(start) * 1000 / restarts;
+
+        benchmark_sink += rcl_sum;
+        printf("%-16s %8d %14.1f %14.1f %14.1f %6s\n", inst->instance_name.c_str(), inst->dimension, sorted_us, rotated_us, rcl_us, (sorted_sum == rotated_sum ? "yes" : "NO"));
+    }
+}
+
+// Every customer in exactly one route, loads within the capacity and matching route_capacities
+bool feasible_solution(const instance& inst, const vector< vector<int> >& routes, const vector<int>& capacities)
+{
+    vector<int> seen(inst.dimension, 0);
+    for(int r = 0; r < (int) routes.size(); ++r)
+    {
+        int load = 0;
+        for(int i = 1; i < (int) routes[r].size(); ++i)
+        {
+            seen[routes[r][i]]++;
+            load += inst.demands[routes[r][i]];
+        }
+        if( routes[r][0] != inst.depot_index || load != capacities[r] || load > inst.uniform_vehicle_capacity ) return false;
+    }
+    for(int v = 0; v < inst.dimension; ++v)
+        if( v != inst.depot_index && seen[v] != 1 ) return false;
+    return true;
+}
+
+// Best improvement descent through the move cache (as in the GRASP) until 10 steps in a row fail
+pair<int, double> cached_descent(shared_ptr<const instance> inst, vector< vector<int> >& routes, vector<int>& capacities)
+{
+    neighborhood_generator generator(inst);
+    generator.set_seed(13);
+    move_cache cache;
+    auto start = chrono::steady_clock::now();
+    cache.rebuild(routes, capacities, *inst);
+    for(int stall = 0; stall < 10; ) stall = ( generator.update_solution_best_improvement(routes, capacities, cache) ? 0 : stall + 1 );
+    return make_pair(total_cost(*inst, routes), elapsed_ms(start));
+}
+
+/*
+ * Initial solutions: cost of the sweep (smart_greedy), of the Split of the same giant tour and of
+ * the Clarke-Wright savings, with the time of each construction (the savings list is built once,
+ * "list(ms)"). Then the GRASP descent from the sweep and from the savings solution, cost and time,
+ * on the instances small enough for it.
+ */
+void bench_savings()
+{
+    vector<string> paths = bench_instances;
+    paths.push_back(write_synthetic_instance(1001));
+    paths.push_back(write_synthetic_instance(10001));
+    printf("%-16s %7s %9s %9s %9s %10s %9s %9s %10s %4s %18s %18s\n", "instance", "n", "sweep", "split", "savings", "list(ms)", "sweep(us)", "split(us)", "savings(us)", "ok", "descent sweep", "descent savings");
+    for(const string& path : paths)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        const int repeats = ( inst->dimension > 5000 ? 5 : 100 );
+        vector< vector<int> > sweep_routes, split_routes, savings_routes;
+        vector<int> sweep_caps, split_caps, savings_caps, tour;
+        int sweep_cost = 0, split_cost = 0, savings_cost = 0;
+
+        auto start = chrono::steady_clock::now();
+        sweep_constructor sweep(inst.get());
+        for(int r = 0; r < repeats; ++r)
+        {
+            sweep.rotated_tour(0, tour);
+            sweep_cost = sweep.sweep_routes(tour, sweep_routes, sweep_caps);
+        }
+        double sweep_us = elapsed_ms(start) * 1000 / repeats;
+
+        start = chrono::steady_clock::now();
+        for(int r = 0; r < repeats; ++r) split_cost = split_giant_tour(tour, *inst, split_routes, split_caps);
+        double split_us = elapsed_ms(start) * 1000 / repeats;
+
+        start = chrono::steady_clock::now();
+        savings_constructor savings(inst.get());
+        double list_ms = elapsed_ms(start);
+        start = chrono::steady_clock::now();
+        for(int r = 0; r < repeats; ++r) savings_cost = savings.build(savings_routes, savings_caps);
+        double savings_us = elapsed_ms(start) * 1000 / repeats;
+
+        bool ok = feasible_solution(*inst, sweep_routes, sweep_caps) && feasible_solution(*inst, split_routes, split_caps) && feasible_solution(*inst, savings_routes, savings_caps)
+               && savings_cost == total_cost(*inst, savings_routes);
+        char from_sweep[32] = "-", from_savings[32] = "-";
+        if( inst->dimension <= 1001 )
+        {
+            pair<int, double> a = cached_descent(inst, sweep_routes, sweep_caps);
+            pair<int, double> b = cached_descent(inst, savings_routes, savings_caps);
+            snprintf(from_sweep, sizeof(from_sweep), "%d/%.0fms", a.first, a.second);
+            snprintf(from_savings, sizeof(from_savings), "%d/%.0fms", b.first, b.second);
+        }
+        printf("%-16s %7d %9d %9d %9d %10.2f %9.1f %9.1f %10.1f %4s %18s %18s\n", inst->instance_name.c_str(), inst->dimension, sweep_cost, split_cost, savings_cost,
+               list_ms, sweep_us, split_us, savings_us, (ok ? "yes" : "NO"), from_sweep, from_savings);
+    }
+}
+
+/*
+ * Solution hashing (solution_hash.h).
+ * 1 - A random walk over every move type checks that the hash kept by move_hash_delta always equals
+ *     solution_hash of the routes, and times both ("delta(ns)" per move, "full(ns)" per solution).
+ * 2 - GRASP restarts (cached descent from the sweep, 10 failed steps to stop) with and without the
+ *     set of known local optima: distinct optima among the restarts, descents stopped on a known
+ *     optimum, the saved time and whether both runs found the same costs.
+ */
+void bench_hashing()
+{
+    const vector<int> all_moves = { EXCHANGE, DELETE_AND_INSERT, TWO_OPT, TWO_OPT_REVERSAL, OR_OPT, TWO_OPT_STAR };
+    const int walk = 200000, restarts = 500;
+    printf("%-16s %9s %10s %10s %9s %9s %9s %11s %11s %5s\n", "instance", "mismatch", "delta(ns)", "full(ns)", "restarts", "distinct", "stops", "plain(ms)", "hashed(ms)", "same");
+    for(const string& path : bench_instances)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        sweep_constructor sweep(inst.get());
+        vector< vector<int> > routes;
+        vector<int> capacities, tour;
+        sweep.rotated_tour(0, tour);
+        sweep.sweep_routes(tour, routes, capacities);
+        reserve_routes(routes, *inst);
+
+        neighborhood_generator generator(inst);
+        generator.set_seed(13);
+        uint64_t hash = solution_hash(routes, inst->depot_index);
+        int mismatches = 0;
+        double delta_ns = 0;
+        for(int step = 0; step < walk; ++step)
+        {
+            move_proposal m = generator.propose_move_custom(routes, capacities, all_moves);
+            if( m.idx1 < 0 ) continue;
+            auto start = chrono::steady_clock::now();
+            hash += move_hash_delta(routes, m, *inst);
+            delta_ns += elapsed_ms(start) * 1e6;
+            generator.apply_move(routes, capacities, m);
+            if( step % 100 == 0 && hash != solution_hash(routes, inst->depot_index) )
+            {
+                mismatches++;
+                hash = solution_hash(routes, inst->depot_index);
+            }
+        }
+        auto start = chrono::steady_clock::now();
+        uint64_t sink = 0;
+        for(int r = 0; r < 10000; ++r) sink += solution_hash(routes, inst->depot_index);
+        double full_ns = elapsed_ms(start) * 1e6 / 10000;
+        benchmark_sink += sink;
+
+        // the GRASP loop of grasp_time_to_target, once without and once with known optima
+        vector<int> costs[2];
+        double run_ms[2];
+        long long stops = 0, distinct = 0;
+        move_cache cache;
+        for(int hashed = 0; hashed < 2; ++hashed)
+        {
+            concurrent_hash_set known_optima(16);
+            start = chrono::steady_clock::now();
+            for(int i = 0; i < restarts; ++i)
+            {
+                generator.set_seed(derive_seed(13, i));
+                sweep.rotated_tour(generator.rng() % inst->dimension, tour);
+                sweep.sweep_routes(tour, routes, capacities);
+                cache.rebuild(routes, capacities, *inst);
+                uint64_t cur = ( hashed ? solution_hash(routes, inst->depot_index) : 0 );
+                for(int stall = 0; stall < 10; )
+                {
+                    if( generator.update_solution_best_improvement(routes, capacities, cache, hashed ? &cur : nullptr) ) stall = 0;
+                    else if( hashed && known_optima.contains(cur) )
+                    {
+                        stops++;
+                        break;
+                    }
+                    else stall++;
+                }
+                if( hashed && cache.best(routes, capacities, *inst, EXCHANGE).delta >= 0 && cache.best(routes, capacities, *inst, DELETE_AND_INSERT).delta >= 0 && known_optima.insert(cur) ) distinct++;
+                costs[hashed].push_back(total_cost(*inst, routes));
+            }
+            run_ms[hashed] = elapsed_ms(start);
+        }
+        printf("%-16s %9d %10.1f %10.1f %9d %9lld %9lld %11.1f %11.1f %5s\n", inst->instance_name.c_str(), mismatches, delta_ns / walk, full_ns,
+               restarts, distinct, stops, run_ms[0], run_ms[1], (costs[0] == costs[1] ? "yes" : "NO"));
+    }
+}
+
+// Fraction of the pairs of different routes whose exchanges / delete_and_inserts are skipped by the bounds
+pair<double, double> pruned_pairs(const instance& inst, const vector< vector<int> >& routes)
+{
+    vector<route_summary> summaries;
+    summarize_routes(routes, inst, summaries);
+    int total_routes = (int) routes.size();
+    long long exchange = 0, relocation = 0, pairs = 0;
+    for(int a = 0; a < total_routes; ++a)
+        for(int b = 0; b < total_routes; ++b)
+        {
+            if( a == b ) continue;
+            pairs++;
+            exchange += !exchange_may_improve(summaries[a], summaries[b]);
+            relocation += !relocation_may_improve(summaries[a], summaries[b]);
+        }
+    if( pairs == 0 ) return make_pair(0.0, 0.0);
+    return make_pair((double) exchange / pairs, (double) relocation / pairs);
+}
+
+/*
+ * Route pair pruning (route_bounds.h): share of the route pairs skipped on the sweep solution and
+ * on the local optimum reached from it, then the same descent with full rescans (original loops,
+ * the gain kernel off: the blocked kernel scans are not pruned) and through the move cache, without
+ * and with the pruning. All the runs must end on the same routes.
+ */
+void bench_pruning()
+{
+    vector<string> paths = bench_instances;
+    paths.push_back(write_synthetic_instance(1001));
+    paths.push_back(write_synthetic_instance(2001));
+    gain_kernel_isa kernel = active_gain_kernel();
+    printf("%-16s %6s %6s %15s %16s %12s %12s %12s %12s %6s\n", "instance", "n", "routes", "start exch/rel", "optimum exch/rel",
+           "rescan(ms)", "pruned(ms)", "cached(ms)", "pruned(ms)", "same");
+    for(const string& path : paths)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        sweep_constructor sweep(inst.get());
+        vector< vector<int> > start_routes, results[2][2];
+        vector<int> start_capacities, tour;
+        sweep.rotated_tour(0, tour);
+        sweep.sweep_routes(tour, start_routes, start_capacities);
+        pair<double, double> at_start = pruned_pairs(*inst, start_routes);
+        double times[2][2] = { { -1, -1 }, { -1, -1 } };
+        for(int cached = 0; cached < 2; ++cached)
+            for(int pruning = 0; pruning < 2; ++pruning)
+            {
+                if( !cached && inst->dimension > 1001 ) continue; // the scalar rescans would take minutes
+                set_gain_kernel( cached ? kernel : KERNEL_OFF );
+                set_route_pruning(pruning);
+                vector< vector<int> > routes = start_routes;
+                vector<int> capacities = start_capacities;
+                neighborhood_generator generator(inst);
+                generator.set_seed(13);
+                move_cache cache;
+                auto start = chrono::steady_clock::now();
+                if( cached ) cache.rebuild(routes, capacities, *inst);
+                for(int stall = 0; stall < 10; )
+                {
+                    bool improved = ( cached ? generator.update_solution_best_improvement(routes, capacities, cache) : generator.update_solution_best_improvement(routes, capacities) );
+                    stall = ( improved ? 0 : stall + 1 );
+                }
+                times[cached][pruning] = elapsed_ms(start);
+                results[cached][pruning] = routes;
+            }
+        set_gain_kernel(kernel);
+        set_route_pruning(true);
+        pair<double, double> at_optimum = pruned_pairs(*inst, results[1][1]);
+        bool same = results[1][0] == results[1][1] && ( times[0][0] < 0 || (results[0][0] == results[0][1] && results[0][0] == results[1][0]) );
+        char rescan[2][32] = { "-", "-" };
+        for(int pruning = 0; pruning < 2; ++pruning)
+            if( times[0][pruning] >= 0 ) snprintf(rescan[pruning], sizeof(rescan[pruning]), "%.1f", times[0][pruning]);
+        char start_share[32], optimum_share[32];
+        snprintf(start_share, sizeof(start_share), "%.0f%%/%.0f%%", 100 * at_start.first, 100 * at_start.second);
+        snprintf(optimum_share, sizeof(optimum_share), "%.0f%%/%.0f%%", 100 * at_optimum.first, 100 * at_optimum.second);
+        printf("%-16s %6d %6d %15s %16s %12s %12s %12.1f %12.1f %6s\n", inst->instance_name.c_str(), inst->dimension, (int) start_routes.size(),
+               start_share, optimum_share, rescan[0], rescan[1], times[1][0], times[1][1], (same ? "yes" : "NO"));
+    }
+}
+
+/*
+ * Grid of points_index against a scan of every point: the neighbor lists built at load (legacy
+ * O(n^2) construction skipped above n = 10001), then random k nearest and radius queries, each
+ * checked against a sort of all the points. The synthetic n = 50001 is past the dense matrix.
+ */
+void bench_spatial()
+{
+    vector<string> paths = bench_instances;
+    for(int dimension : { 1001, 10001, 50001 }) paths.push_back(write_synthetic_instance(dimension));
+    const int queries = 1000, k = 50;
+    printf("%-16s %7s %10s %10s %12s %12s %13s %13s %6s\n", "instance", "n", "load(ms)", "grid(ms)", "legacy(ms)", "lists(ms)",
+           "scan(us/q)", "grid(us/q)", "same");
+    for(const string& path : paths)
+    {
+        auto start = chrono::steady_clock::now();
+        instance inst(path);
+        double load_ms = elapsed_ms(start);
+        start = chrono::steady_clock::now();
+        inst.initialize_spatial_index();
+        double grid_ms = elapsed_ms(start);
+        start = chrono::steady_clock::now();
+        inst.initialize_neighbor_lists(DEFAULT_NEIGHBOR_LIST_SIZE);
+        double lists_ms = elapsed_ms(start);
+        bool same = true;
+        char legacy[32] = "-";
+        if( inst.dimension <= 10001 )
+        {
+            vector< vector<int> > indexed = inst.nearest_neighbors;
+            start = chrono::steady_clock::now();
+            inst.initialize_neighbor_lists_legacy(DEFAULT_NEIGHBOR_LIST_SIZE);
+            snprintf(legacy, sizeof(legacy), "%.1f", elapsed_ms(start));
+            same = ( indexed == inst.nearest_neighbors );
+        }
+
+        // queries from random points of the bounding box, the radius that of the k-th nearest
+        mt19937 rng(13);
+        const spatial_index& grid = inst.points_index;
+        vector< pair<int, int> > centers;
+        for(int q = 0; q < queries; ++q)
+            centers.emplace_back(grid.min_x + (int) (rng() % (grid.max_x - grid.min_x + 1)), grid.min_y + (int) (rng() % (grid.max_y - grid.min_y + 1)));
+        auto accept = [&] (int v) { return v != inst.depot_index; };
+        vector< vector<int> > scanned(queries), gridded(queries), scanned_within(queries), gridded_within(queries);
+        vector< pair<int, int> > order;
+        start = chrono::steady_clock::now();
+        for(int q = 0; q < queries; ++q)
+        {
+            order.clear();
+            for(int v = 0; v < inst.dimension; ++v)
+                if( accept(v) ) order.emplace_back(euclidean_distance(centers[q], inst.points[v]), v);
+            int size = min(k, (int) order.size());
+            partial_sort(order.begin(), order.begin() + size, order.end());
+            for(int i = 0; i < size; ++i) scanned[q].push_back(order[i].second);
+            for(const pair<int, int>& entry : order)
+                if( entry.first <= order[size - 1].first ) scanned_within[q].push_back(entry.second);
+        }
+        double scan_us = elapsed_ms(start) * 1000 / queries;
+        start = chrono::steady_clock::now();
+        for(int q = 0; q < queries; ++q)
+        {
+            grid.nearest(centers[q], k, accept, gridded[q]);
+            grid.within(centers[q], euclidean_distance(centers[q], inst.points[gridded[q].back()]), accept, gridded_within[q]);
+        }
+        double grid_us = elapsed_ms(start) * 1000 / queries;
+        for(int q = 0; q < queries; ++q)
+        {
+            sort(scanned_within[q].begin(), scanned_within[q].end());
+            sort(gridded_within[q].begin(), gridded_within[q].end());
+            same = same && scanned[q] == gridded[q] && scanned_within[q] == gridded_within[q];
+        }
+        printf("%-16s %7d %10.1f %10.2f %12s %12.2f %13.1f %13.2f %6s\n", inst.instance_name.c_str(), inst.dimension, load_ms, grid_ms, legacy,
+               lists_ms, scan_us, grid_us, (same ? "yes" : "NO"));
+    }
+}
+
+// Options of the regression suites
+struct report_options
+{
+    unsigned seed = 13;
+    int samples = 200;           // timed calls of each operator and construction
+    int runs = 10;               // seeds of each time to target curve
+    double target_gap = 0.08;    // time to target: stop 8% above the BKS
+    double time_limit_ms = 2000; // time to target: a run that has not reached it by then failed
+    string json_path, csv_path;
+};
+
+report_options options;
+bench_report report;
+
+// Times `samples` calls of body, each after an untimed setup; returns ns per call
+vector<double> time_calls(int samples, const function<void()>& setup, const function<void()>& body)
+{
+    vector<double> times;
+    for(int s = 0; s < samples; ++s)
+    {
+        setup();
+        auto start = chrono::steady_clock::now();
+        body();
+        times.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+    }
+    return times;
+}
+
+void add_timing(const string& suite, const string& name, const string& instance_name, const vector<double>& ns)
+{
+    bench_record record;
+    record.suite = suite;
+    record.name = name;
+    record.instance = instance_name;
+    record.unit = "ns";
+    record.stats = summarize(ns);
+    record.per_second = ( record.stats.median > 0 ? 1e9 / record.stats.median : 0 );
+    report.add(record);
+}
+
+void print_report_header()
+{
+    printf("%-12s %-28s %-16s %5s %12s %12s %12s %12s %-3s %12s\n", "suite", "name", "instance", "n", "p10", "median", "p90", "p99", "", "per second");
+}
+
+/*
+ * Neighborhood operators on the sweep solution of each instance: one full best improvement scan
+ * per sample, from the same routes every time (restored outside of the timing). route_cost and
+ * propose_move are too short to time alone, so their samples are the mean of a batch of calls.
+ */
+void bench_operators()
+{
+    typedef bool (*best_operator)(vector< vector<int> >&, vector<int>&, const instance&);
+    vector< pair<string, best_operator> > operators = {
+        { "apply_best_exchange", apply_best_exchange }, { "apply_best_delete_and_insert", apply_best_delete_and_insert },
+        { "apply_best_two_opt", apply_best_two_opt }, { "apply_best_or_opt", apply_best_or_opt }, { "apply_best_two_opt_star", apply_best_two_opt_star } };
+    print_report_header();
+    for(const string& path : bench_instances)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        vector< vector<int> > start_routes, routes;
+        vector<int> start_capacities, capacities, tour;
+        sweep_constructor sweep(inst.get());
+        sweep.rotated_tour(0, tour);
+        sweep.sweep_routes(tour, start_routes, start_capacities);
+
+        for(const auto& op : operators)
+        {
+            add_timing("operators", op.first, inst->instance_name, time_calls(options.samples,
+                [&] { routes = start_routes; capacities = start_capacities; },
+                [&] { op.second(routes, capacities, *inst); }));
+        }
+
+        long long sink = 0;
+        vector<double> per_route = time_calls(options.samples, [] {}, [&] { for(const auto& route : start_routes) sink += route_cost(route, *inst); });
+        for(double& t : per_route) t /= start_routes.size();
+        add_timing("operators", "route_cost", inst->instance_name, per_route);
+
+        const int batch = 1000;
+        neighborhood_generator generator(inst);
+        generator.set_seed(options.seed);
+        vector<double> per_proposal = time_calls(options.samples, [] {}, [&] { for(int b = 0; b < batch; ++b) sink += generator.propose_move(start_routes, start_capacities).delta; });
+        for(double& t : per_proposal) t /= batch;
+        add_timing("operators", "propose_move", inst->instance_name, per_proposal);
+        benchmark_sink += sink;
+    }
+}
+
+// Constructions of the initial solution, one per sample, on the X instances and a synthetic n = 1001
+void bench_construction()
+{
+    vector<string> paths = bench_instances;
+    paths.push_back(write_synthetic_instance(1001));
+    print_report_header();
+    for(const string& path : paths)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(path);
+        const string& name = inst->instance_name;
+        vector< vector<int> > routes;
+        vector<int> capacities, tour;
+        mt19937 rng(options.seed);
+        int restart = 0;
+        sweep_constructor sweep(inst.get());
+        savings_constructor savings(inst.get());
+        sweep.rotated_tour(0, tour);
+
+        add_timing("construction", "initial_solution_greedy", name, time_calls(options.samples, [] {}, [&] { first_fit_solution(*inst, routes, capacities); }));
+        add_timing("construction", "smart_greedy", name, time_calls(options.samples, [] {}, [&] {
+            sweep.rotated_tour(restart++ % (inst->dimension - 1), tour);
+            sweep.sweep_routes(tour, routes, capacities);
+        }));
+        add_timing("construction", "randomized_sweep", name, time_calls(options.samples, [] {}, [&] {
+            sweep.randomized_sweep(restart++, 0.3, 8, rng, routes, capacities);
+        }));
+        add_timing("construction", "split", name, time_calls(options.samples, [] {}, [&] { split_giant_tour(tour, *inst, routes, capacities); }));
+        add_timing("construction", "savings", name, time_calls(options.samples, [] {}, [&] { savings.build(routes, capacities); }));
+        add_timing("construction", "savings_randomized", name, time_calls(options.samples, [] {}, [&] { savings.build(routes, capacities, 0.1, &rng); }));
+        add_timing("construction", "savings_list", name, time_calls(max(1, options.samples / 10), [] {}, [&] { savings_constructor list(inst.get()); }));
+    }
+}
+
+/*
+ * GRASP restarts as in grasp_solver.cpp (the solver is an executable of its own): construction,
+ * then the cached best improvement descent until 10 steps in a row fail. Restart i uses the seed
+ * derive_seed(seed, i), like the solver. Returns the wall time (ms) at which the best cost reached
+ * target, or -1 if time_limit_ms ran out first; restarts gets the number of restarts done.
+ */
+double grasp_time_to_target(shared_ptr<const instance> inst, unsigned seed, int target, double time_limit_ms, bool savings_start, int& restarts)
+{
+    auto start = chrono::steady_clock::now();
+    neighborhood_generator generator(inst);
+    sweep_constructor sweep(inst.get());
+    savings_constructor savings;
+    if( savings_start ) savings = savings_constructor(inst.get());
+    vector< vector<int> > routes;
+    vector<int> capacities, tour;
+    move_cache cache;
+    for(restarts = 0; elapsed_ms(start) < time_limit_ms; ++restarts)
+    {
+        generator.set_seed(derive_seed(seed, restarts));
+        if( savings_start ) savings.build(routes, capacities, 0.1, &generator.rng);
+        else
+        {
+            sweep.rotated_tour(generator.rng() % inst->dimension, tour);
+            sweep.sweep_routes(tour, routes, capacities);
+        }
+        cache.rebuild(routes, capacities, *inst);
+        for(int stall = 0; stall < 10; ) stall = ( generator.update_solution_best_improvement(routes, capacities, cache) ? 0 : stall + 1 );
+        if( total_cost(*inst, routes) <= target ) return elapsed_ms(start);
+    }
+    return -1;
+}
+
+/*
+ * Time to target curves: options.runs GRASP runs per instance and construction, seeds derived
+ * from options.seed. A run that misses the target counts as options.time_limit_ms in the
+ * percentiles; success_rate is the fraction that reached it, per_second the restarts per second.
+ */
+void bench_time_to_target()
+{
+    const vector<int> bks = { 27591, 14971, 12747, 19565 };
+    print_report_header();
+    for(int i = 0; i < (int) bench_instances.size(); ++i)
+    {
+        shared_ptr<const instance> inst = load_shared_instance(bench_instances[i]);
+        int target = search_limits::target_from_gap(bks[i], options.target_gap);
+        for(int savings_start = 0; savings_start < 2; ++savings_start)
+        {
+            vector<double> times;
+            int reached = 0;
+            long long total_restarts = 0;
+            double total_ms = 0;
+            for(int run = 0; run < options.runs; ++run)
+            {
+                int restarts = 0;
+                double ms = grasp_time_to_target(inst, derive_seed(options.seed, run), target, options.time_limit_ms, savings_start, restarts);
+                reached += ( ms >= 0 );
+                times.push_back( ms >= 0 ? ms : options.time_limit_ms );
+                total_restarts += restarts + ( ms >= 0 );
+                total_ms += times.back();
+            }
+            bench_record record;
+            record.suite = "ttt";
+            record.name = ( savings_start ? "grasp_savings" : "grasp_sweep" );
+            record.instance = inst->instance_name;
+            record.unit = "ms";
+            record.stats = summarize(times);
+            record.per_second = 1000.0 * total_restarts / total_ms;
+            record.success_rate = (double) reached / options.runs;
+            report.add(record);
+        }
+    }
+}
+
+// Rejects an argument main does not understand, with the usage of the header comment
+int usage_error(const string& arg)
+{
+    fprintf(stderr, "Invalid option: %s\n", arg.c_str());
+    fprintf(stderr, "Usage: ./BENCHMARK [granular|distances|sharing|loader|flat|cache|kernel|cost|sweep|savings|hashing|pruning|spatial]\n");
+    fprintf(stderr, "       ./BENCHMARK [operators|construction|ttt|report] [--json file] [--csv file] [--seed s] [--samples n] [--runs n] [--target-gap g] [--time-limit ms]\n");
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    const vector<string> modes = { "all", "granular", "distances", "sharing", "loader", "flat", "cache", "kernel", "cost", "sweep", "savings",
+                                   "hashing", "pruning", "spatial", "operators", "construction", "ttt", "report" };
+    string mode = (argc > 1 ? argv[1] : "all");
+    if( find(modes.begin(), modes.end(), mode) == modes.end() ) return usage_error(mode);
+    for(int a = 2; a < argc; ++a)
+    {
+        string arg = argv[a];
+        if( arg == "--json" && a + 1 < argc ) options.json_path = argv[++a];
+        else if( arg == "--csv" && a + 1 < argc ) options.csv_path = argv[++a];
+        else if( arg == "--seed" && a + 1 < argc ) options.seed = (unsigned) atoll(argv[++a]);
+        else if( arg == "--samples" && a + 1 < argc ) options.samples = max(1, atoi(argv[++a]));
+        else if( arg == "--runs" && a + 1 < argc ) options.runs = max(1, atoi(argv[++a]));
+        else if( arg == "--target-gap" && a + 1 < argc ) options.target_gap = atof(argv[++a]);
+        else if( arg == "--time-limit" && a + 1 < argc ) options.time_limit_ms = atof(argv[++a]);
+        else return usage_error(arg);
+    }
+    report.seed = options.seed;
+    if( mode == "all" || mode == "granular" ) bench_granular();
+    if( mode == "all" || mode == "distances" ) bench_distances();
+    if( mode == "all" || mode == "sharing" ) bench_instance_sharing();
+    if( mode == "all" || mode == "loader" ) bench_loader();
+    if( mode == "all" || mode == "flat" ) bench_flat_solution();
+    if( mode == "all" || mode == "cache" ) bench_move_cache();
+    if( mode == "all" || mode == "kernel" ) bench_gain_kernel();
+    if( mode == "all" || mode == "cost" ) bench_cost_evaluator();
+    if( mode == "all" || mode == "sweep" ) bench_sweep();
+    if( mode == "all" || mode == "savings" ) bench_savings();
+    if( mode == "all" || mode == "hashing" ) bench_hashing();
+    if( mode == "all" || mode == "pruning" ) bench_pruning();
+    if( mode == "all" || mode == "spatial" ) bench_spatial();
+    if( mode == "all" || mode == "report" || mode == "operators" ) bench_operators();
+    if( mode == "all" || mode == "report" || mode == "construction" ) bench_construction();
+    if( mode == "all" || mode == "report" || mode == "ttt" ) bench_time_to_target();
+    bool written = true;
+    if( !options.json_path.empty() ) written &= report.write_json(options.json_path);
+    if( !options.csv_path.empty() ) written &= report.write_csv(options.csv_path);
+    return ( written ? 0 : 1 );
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include "construction.h"
+#include "cost_evaluator.h"
+
+sweep_constructor::sweep_constructor( const instance* _data_inst ) : data_inst(_data_inst)
+{
+    pair<int, int> center = data_inst->points[data_inst->depot_index];
+    for(int p = 0; p < data_inst->dimension; ++p)
+        if( p != data_inst->depot_index ) polar_order.push_back(p);
+    // Radial sort (the comparator of the original smart_greedy, so the order is the same)
+    sort( polar_order.begin(), polar_order.end(), [&] (int a, int b)
+    {
+        pair<int, int> pa = make_pair(data_inst->points[a].first - center.first, data_inst->points[a].second - center.second);
+        pair<int, int> pb = make_pair(data_inst->points[b].first - center.first, data_inst->points[b].second - center.second);
+        int cross_product = pa.first * pb.second - pa.second * pb.first;
+        if( cross_product != 0 ) return (cross_product > 0);
+        return pa.first * pa.first + pa.second * pa.second < pb.first * pb.first + pb.second * pb.second;
+    });
+}
+
+void sweep_constructor::rotated_tour( int offset, vector<int>& tour ) const
+{
+    int n = (int) polar_order.size();
+    offset %= n;
+    tour.resize(n);
+    copy(polar_order.begin() + offset, polar_order.end(), tour.begin());
+    copy(polar_order.begin(), polar_order.begin() + offset, tour.begin() + (n - offset));
+}
+
+// Makes routes hold `used` routes, reusing the buffers it already has
+static vector<int>& open_route( vector< vector<int> >& routes, vector<int>& route_capacities, int used, int depot )
+{
+    if( used == (int) routes.size() ) routes.emplace_back();
+    if( used == (int) route_capacities.size() ) route_capacities.push_back(0);
+    routes[used].assign(1, depot);
+    route_capacities[used] = 0;
+    return routes[used];
+}
+
+int sweep_constructor::sweep_routes( const vector<int>& tour, vector< vector<int> >& routes, vector<int>& route_capacities ) const
+{
+    int used = 0, capacity = data_inst->uniform_vehicle_capacity;
+    vector<int>* route = &open_route(routes, route_capacities, used++, data_inst->depot_index);
+    for(const int customer : tour)
+    {
+        int demand = data_inst->demands[customer];
+        if( route_capacities[used - 1] + demand > capacity ) route = &open_route(routes, route_capacities, used++, data_inst->depot_index);
+        route->push_back(customer);
+        route_capacities[used - 1] += demand;
+    }
+    routes.resize(used);
+    route_capacities.resize(used);
+    int cost = 0;
+    for(const vector<int>& r : routes) cost += route_cost(r, *data_inst);
+    return cost;
+}
+
+int sweep_constructor::randomized_sweep( int offset, double alpha, int window, mt19937& rng, vector< vector<int> >& routes, vector<int>& route_capacities )
+{
+    const distance_matrix& d = data_inst->distances;
+    int n = (int) polar_order.size(), capacity = data_inst->uniform_vehicle_capacity;
+    offset %= n;
+    next.resize(n);
+    prev.resize(n);
+    for(int k = 0; k < n; ++k)
+    {
+        next[k] = (k + 1) % n;
+        prev[k] = (k + n - 1) % n;
+    }
+
+    int used = 0, remaining = n, head = offset;
+    vector<int>* route = &open_route(routes, route_capacities, used++, data_inst->depot_index);
+    while( remaining > 0 )
+    {
+        // candidates: the first `window` unrouted customers of the sweep that fit in the route
+        candidates.clear();
+        int best = 0x3f3f3f3f, worst = 0, last = route->back();
+        int k = head;
+        for(int seen = 0; seen < min(window, remaining); ++seen, k = next[k])
+        {
+            int customer = polar_order[k];
+            if( route_capacities[used - 1] + data_inst->demands[customer] > capacity ) continue;
+            int cost = d.dist(last, customer);
+            best = min(best, cost);
+            worst = max(worst, cost);
+            candidates.push_back(k);
+        }
+        if( candidates.empty() )
+        {
+            route = &open_route(routes, route_capacities, used++, data_inst->depot_index);
+            continue;
+        }
+        int threshold = best + (int) (alpha * (worst - best));
+        int eligible = 0;
+        for(int c : candidates) eligible += ( d.dist(last, polar_order[c]) <= threshold );
+        int pick = (int) (rng() % eligible);
+        for(int c : candidates)
+        {
+            if( d.dist(last, polar_order[c]) > threshold || pick-- > 0 ) continue;
+            int customer = polar_order[c];
+            route->push_back(customer);
+            route_capacities[used - 1] += data_inst->demands[customer];
+            // unlink the position from the sweep
+            if( c == head ) head = next[c];
+            next[prev[c]] = next[c];
+            prev[next[c]] = prev[c];
+            remaining--;
+            break;
+        }
+    }
+    routes.resize(used);
+    route_capacities.resize(used);
+    int cost = 0;
+    for(const vector<int>& r : routes) cost += route_cost(r, *data_inst);
+    return cost;
+}
+
+savings_constructor::savings_constructor( const instance* _data_inst ) : data_inst(_data_inst)
+{
+    const distance_matrix& d = data_inst->distances;
+    int depot = data_inst->depot_index;
+    auto add_pair = [&] (int i, int j)
+    {
+        int value = d.dist(depot, i) + d.dist(depot, j) - d.dist(i, j);
+        if( value > 0 ) savings.push_back({ value, min(i, j), max(i, j) });
+    };
+    for(int i = 0; i < data_inst->dimension; ++i)
+    {
+        if( i == depot ) continue;
+        // Without neighbor lists every pair is considered (n^2 savings)
+        if( data_inst->nearest_neighbors.empty() || data_inst->nearest_neighbors[i].empty() )
+        {
+            for(int j = i + 1; j < data_inst->dimension; ++j)
+                if( j != depot ) add_pair(i, j);
+        }
+        else for(const int j : data_inst->nearest_neighbors[i]) add_pair(i, j);
+    }
+    // j in the list of i and i in the list of j give the same pair
+    sort( savings.begin(), savings.end(), [] (const saving& a, const saving& b) { return make_pair(a.i, a.j) < make_pair(b.i, b.j); } );
+    savings.erase( unique( savings.begin(), savings.end(), [] (const saving& a, const saving& b) { return a.i == b.i && a.j == b.j; } ), savings.end() );
+}
+
+int savings_constructor::find_route( int v )
+{
+    while( parent[v] != v )
+    {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+int savings_constructor::build( vector< vector<int> >& routes, vector<int>& route_capacities, double noise, mt19937* rng )
+{
+    int n = data_inst->dimension, depot = data_inst->depot_index, capacity = data_inst->uniform_vehicle_capacity;
+    links.assign(2 * n, -1);
+    parent.resize(n);
+    load.resize(n);
+    for(int v = 0; v < n; ++v)
+    {
+        parent[v] = v;
+        load[v] = data_inst->demands[v];
+    }
+
+    heap.resize(savings.size());
+    uniform_real_distribution<double> factor(1.0 - noise, 1.0);
+    for(size_t s = 0; s < savings.size(); ++s)
+    {
+        double key = savings[s].value;
+        if( noise > 0 ) key *= factor(*rng);
+        heap[s] = { key, savings[s].i, savings[s].j };
+    }
+    make_heap(heap.begin(), heap.end());
+
+    auto is_endpoint = [&] (int v) { return links[2 * v] == -1 || links[2 * v + 1] == -1; };
+    auto link = [&] (int v, int u) { links[2 * v + ( links[2 * v] == -1 ? 0 : 1 )] = u; };
+    for(size_t remaining = heap.size(); remaining > 0; --remaining)
+    {
+        pop_heap(heap.begin(), heap.begin() + remaining);
+        int i = heap[remaining - 1].i, j = heap[remaining - 1].j;
+        if( !is_endpoint(i) || !is_endpoint(j) ) continue;
+        int route_i = find_route(i), route_j = find_route(j);
+        if( route_i == route_j || load[route_i] + load[route_j] > capacity ) continue;
+        link(i, j);
+        link(j, i);
+        // union by load keeps the trees shallow enough with the path halving of find_route
+        if( load[route_i] < load[route_j] ) swap(route_i, route_j);
+        parent[route_j] = route_i;
+        load[route_i] += load[route_j];
+    }
+
+    // Walks every path from the endpoint met first, customers in index order
+    routed.assign(n, 0);
+    int used = 0;
+    for(int v = 0; v < n; ++v)
+    {
+        if( v == depot || routed[v] || !is_endpoint(v) ) continue;
+        vector<int>& route = open_route(routes, route_capacities, used++, depot);
+        route_capacities[used - 1] = load[find_route(v)];
+        for(int previous = -1, current = v; current != -1; )
+        {
+            route.push_back(current);
+            routed[current] = 1;
+            int next = ( links[2 * current] == previous ? links[2 * current + 1] : links[2 * current] );
+            previous = current;
+            current = next;
+        }
+    }
+    routes.resize(used);
+    route_capacities.resize(used);
+    int cost = 0;
+    for(const vector<int>& r : routes) cost += route_cost(r, *data_inst);
+    return cost;
+}
@@ -0,0 +1,93 @@
+#ifndef CONSTRUCTION_H
+#define CONSTRUCTION_H
+
+#include <vector>
+#include <random>
+#include "data_loader.h"
+
+using namespace std;
+
+/*
+ * Sweep construction shared by the solvers.
+ * The customers are sorted once by the angle they make with the depot (ties by distance to it);
+ * every construction after that is a rotation of this polar order, so a GRASP restart only picks
+ * an offset: the giant tour is written in O(n) into buffers kept between calls, without sorting.
+ *
+ * sweep_routes fills the routes greedily along a tour: the next customer goes into the last route
+ * while it fits, otherwise it opens a new one (the original smart_greedy).
+ * randomized_sweep is the GRASP construction with a restricted candidate list: the next customer
+ * of the current route is drawn among the first `window` unrouted customers of the sweep that fit
+ * in it, restricted to those whose distance to the end of the route is within
+ * min + alpha * (max - min). alpha = 0 is the greedy nearest choice, alpha = 1 is uniform.
+ *
+ * Not thread safe (the buffers); every solver owns its constructor.
+ */
+struct sweep_constructor
+{
+    const instance* data_inst;
+    vector<int> polar_order;  // customers sorted by angle around the depot
+    vector<int> next, prev;   // unrouted customers of randomized_sweep, as a circular list over polar_order
+    vector<int> candidates;
+
+    // Giant tour starting at position offset of the polar order (offset is taken modulo its size)
+    void rotated_tour( int offset, vector<int>& tour ) const;
+
+    // Cuts tour greedily into routes; returns the cost of the solution
+    int sweep_routes( const vector<int>& tour, vector< vector<int> >& routes, vector<int>& route_capacities ) const;
+
+    // Randomized sweep starting at position offset of the polar order; returns the cost of the solution
+    int randomized_sweep( int offset, double alpha, int window, mt19937& rng, vector< vector<int> >& routes, vector<int>& route_capacities );
+
+    explicit sweep_constructor( const instance* _data_inst );
+    sweep_constructor() : data_inst(nullptr) {}
+};
+
+/*
+ * Clarke-Wright parallel savings construction.
+ * Every customer starts in its own route; the pair (i, j) saves d(0, i) + d(0, j) - d(i, j) if the
+ * routes ending at i and j are joined by the edge i - j. Only the pairs where j is one of the
+ * granular neighbors of i (instance::nearest_neighbors) get a saving, so there are O(n * k) of
+ * them instead of n^2; they are computed once, in the constructor.
+ * build pops the savings from a binary heap, best first, and merges the two routes when i and j
+ * are still route endpoints, belong to different routes (union-find) and the joined load fits.
+ * Routes are kept as undirected paths (two links per customer, -1 is the depot), so joining two
+ * routes never reverses one of them. O(n k log(n k)) overall.
+ *
+ * With noise > 0 every saving is multiplied by a random factor in [1 - noise, 1] before the heap
+ * is built (randomized savings), so the GRASP restarts start from different solutions.
+ * Not thread safe (the buffers); every solver owns its constructor.
+ */
+struct savings_constructor
+{
+    struct saving
+    {
+        int value, i, j;
+    };
+    struct heap_entry
+    {
+        double key;
+        int i, j;
+        bool operator<( const heap_entry& other ) const
+        {
+            if( key != other.key ) return key < other.key;
+            return make_pair(other.i, other.j) < make_pair(i, j); // ties: the smallest pair first
+        }
+    };
+
+    const instance* data_inst;
+    vector<saving> savings;   // positive savings of the neighbor pairs, each pair once
+    vector<heap_entry> heap;
+    vector<int> links;        // links[2 v] and links[2 v + 1]: neighbors of v in its route, -1 is the depot
+    vector<int> parent, load; // union-find over the routes; load is kept at the root
+    vector<char> routed;
+
+    int find_route( int v );
+
+    // Builds the routes; rng is only used when noise > 0. Returns the cost of the solution
+    int build( vector< vector<int> >& routes, vector<int>& route_capacities, double noise = 0, mt19937* rng = nullptr );
+
+    explicit savings_constructor( const instance* _data_inst );
+    savings_constructor() : data_inst(nullptr) {}
+};
+
+#endif
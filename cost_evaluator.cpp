@@ -0,0 +1,41 @@
+#include "cost_evaluator.h"
+#include "instrumentation.h"
+
+int route_cost( const vector<int>& route, const instance& data_inst )
+{
+    const distance_matrix& d = data_inst.distances;
+    int cost = 0;
+    for(int i = 1; i < (int) route.size(); ++i) cost += d.dist(route[i - 1], route[i]);
+    return cost + d.dist(route.back(), data_inst.depot_index);
+}
+
+int cost_evaluator::solution_cost( const vector< vector<int> >& routes )
+{
+    INSTRUMENT( phase_timer timing(PHASE_COST_EVALUATION); )
+    int total = (int) routes.size();
+    if( (int) cached_routes.size() < total )
+    {
+        cached_routes.resize(total);
+        cached_costs.resize(total, 0);
+    }
+    int cost = 0;
+    for(int r = 0; r < total; ++r)
+    {
+        // the comparison is a sequential scan, much cheaper than the scattered matrix reads
+        if( cached_routes[r] != routes[r] )
+        {
+            cached_routes[r] = routes[r];
+            cached_costs[r] = ::route_cost(routes[r], *data_inst);
+            summed_routes++;
+        }
+        else reused_routes++;
+        cost += cached_costs[r];
+    }
+    return cost;
+}
+
+void cost_evaluator::clear()
+{
+    cached_routes.clear();
+    cached_costs.clear();
+}
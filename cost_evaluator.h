@@ -0,0 +1,37 @@
+#ifndef COST_EVALUATOR_H
+#define COST_EVALUATOR_H
+
+#include <vector>
+#include "data_loader.h"
+
+using namespace std;
+
+// Cost of one route (depot first, closed back to the depot), read from data_inst.distances
+int route_cost( const vector<int>& route, const instance& data_inst );
+
+/*
+ * Evaluates solution costs for the solvers, always through the instance's distance_matrix
+ * (dense, triangular or computed on the fly, chosen by size when the instance is loaded), so
+ * every solver reports the same cost for the same routes.
+ * The cost of each route is kept together with a copy of the route: a route that did not change
+ * since the last evaluation is only compared, not summed again, so after a move that touches
+ * two routes only those two are walked through the matrix.
+ * Not thread safe; every solver owns its evaluator.
+ */
+struct cost_evaluator
+{
+    const instance* data_inst;
+    vector< vector<int> > cached_routes; // route r as it was when cached_costs[r] was computed
+    vector<int> cached_costs;
+    long long summed_routes = 0, reused_routes = 0;
+
+    int solution_cost( const vector< vector<int> >& routes );
+    int route_cost( const vector<int>& route ) const { return ::route_cost(route, *data_inst); }
+    // forgets every cached route (e.g. when the routes are rebuilt from scratch)
+    void clear();
+
+    explicit cost_evaluator( const instance* _data_inst ) : data_inst(_data_inst) {}
+    cost_evaluator() : data_inst(nullptr) {}
+};
+
+#endif
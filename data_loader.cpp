@@ -1,6 +1,12 @@
 #include "data_loader.h"
-
-constexpr int INF = 0x3f3f3f3f;
+#include <map>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 vector< string > split_line( string& line )
 {
@@ -11,29 +17,212 @@ vector< string > split_line( string& line )
     return words;
 }
 
-inline int euclidean_distance( const pair<int, int>& a, const pair<int, int>& b)
+void instance::initialize_distances( size_t memory_budget )
+{
+    distances.build( points, distance_matrix::choose_mode(dimension, memory_budget) );
+}
+
+void instance::initialize_spatial_index()
 {
-    int dx = (a.first - b.first) * (a.first - b.first);
-    int dy = (a.second - b.second) * (a.second - b.second);
-    return (int) ceil( sqrt( dx + dy) );
+    points_index.build( points );
 }
 
-void instance::initialize_adjacency_matrix()
+void instance::initialize_neighbor_lists( int k )
 {
-    adjacency_matrix.assign(dimension, vector<int>(dimension, INF) );
-    for(int i = 0; i < dimension; ++i)
+    nearest_neighbors.assign(dimension, vector<int>());
+    k = max(0, min(k, dimension - 2));
+    for(int v = 0; v < dimension; ++v)
+        points_index.nearest( points[v], k, [&] (int u) { return u != v && u != depot_index; }, nearest_neighbors[v] );
+}
+
+void instance::initialize_neighbor_lists_legacy( int k )
+{
+    nearest_neighbors.assign(dimension, vector<int>());
+    k = max(0, min(k, dimension - 2));
+    vector<int> candidates;
+    for(int v = 0; v < dimension; ++v)
     {
-        for(int j = i + 1; j < dimension; ++j)
+        candidates.clear();
+        for(int u = 0; u < dimension; ++u)
+            if( u != v && u != depot_index ) candidates.push_back(u);
+        int list_size = min(k, (int) candidates.size());
+        partial_sort(candidates.begin(), candidates.begin() + list_size, candidates.end(), [&] (int a, int b)
         {
-            adjacency_matrix[i][j] = adjacency_matrix[j][i] = euclidean_distance(points[i], points[j]);
-        }
+            int da = distances.dist(v, a), db = distances.dist(v, b);
+            if( da != db ) return da < db;
+            return a < b;
+        });
+        nearest_neighbors[v].assign(candidates.begin(), candidates.begin() + list_size);
     }
 }
 
-instance::instance( string _path_to_instance )
+instance::instance( string _path_to_instance, int neighbor_list_size, size_t distance_memory_budget )
 {
     path_to_instance = _path_to_instance;
-    ifstream in(path_to_instance);
+    parse_file( path_to_instance );
+    initialize_distances( distance_memory_budget );
+    initialize_spatial_index();
+    initialize_neighbor_lists( neighbor_list_size );
+}
+
+// Cursor over the mapped file. Numbers are read in place, nothing is allocated while scanning
+struct text_scanner
+{
+    const char* pos;
+    const char* end;
+
+    void skip_blanks() { while( pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r') ) ++pos; }
+    void skip_whitespace() { while( pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n') ) ++pos; }
+    void skip_line()
+    {
+        while( pos < end && *pos != '\n' ) ++pos;
+        if( pos < end ) ++pos;
+    }
+
+    // Keyword at the start of the line, ends at a blank or at ':'
+    pair<const char*, const char*> keyword()
+    {
+        skip_whitespace();
+        const char* first = pos;
+        while( pos < end && *pos != ':' && *pos != ' ' && *pos != '\t' && *pos != '\r' && *pos != '\n' ) ++pos;
+        return make_pair(first, pos);
+    }
+
+    // Rest of a "KEY : value" line, without the ':' and the surrounding blanks
+    pair<const char*, const char*> value()
+    {
+        skip_blanks();
+        if( pos < end && *pos == ':' ) ++pos;
+        skip_blanks();
+        const char* first = pos;
+        while( pos < end && *pos != '\n' ) ++pos;
+        const char* last = pos;
+        while( last > first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r') ) --last;
+        return make_pair(first, last);
+    }
+
+    // Reads a (possibly signed or fractional) number truncated toward zero, as stoi in parse_file_legacy
+    bool read_int( int& result )
+    {
+        skip_whitespace();
+        bool negative = false;
+        if( pos < end && (*pos == '-' || *pos == '+') ) negative = (*pos++ == '-');
+        if( pos >= end || ((*pos < '0' || *pos > '9') && *pos != '.') ) return false;
+        long long integer = 0;
+        while( pos < end && *pos >= '0' && *pos <= '9' ) integer = integer * 10 + (*pos++ - '0');
+        if( pos < end && *pos == '.' )
+        {
+            ++pos;
+            while( pos < end && *pos >= '0' && *pos <= '9' ) ++pos;
+        }
+        result = (int) (negative ? -integer : integer);
+        return true;
+    }
+};
+
+bool same_word( const pair<const char*, const char*>& word, const char* expected )
+{
+    size_t length = word.second - word.first;
+    return length == strlen(expected) && memcmp(word.first, expected, length) == 0;
+}
+
+void parse_error( const string& path, const string& message )
+{
+    cerr << path << ": " << message << endl;
+    exit(1);
+}
+
+void instance::parse_file( const string& path )
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if( fd < 0 ) parse_error(path, "could not open the instance file");
+    struct stat file_info;
+    if( fstat(fd, &file_info) != 0 || file_info.st_size == 0 ) parse_error(path, "empty instance file");
+    size_t file_size = file_info.st_size;
+    void* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( mapped == MAP_FAILED ) parse_error(path, "could not map the instance file");
+    madvise(mapped, file_size, MADV_SEQUENTIAL);
+
+    text_scanner in { (const char*) mapped, (const char*) mapped + file_size };
+    dimension = 0;
+    uniform_vehicle_capacity = 0;
+    depot_index = -1;
+    points.clear();
+    demands.clear();
+    bool has_coordinates = false, has_demands = false;
+    int value;
+
+    while( in.pos < in.end )
+    {
+        auto key = in.keyword();
+        if( key.first == key.second ) break;
+        if( same_word(key, "EOF") ) break;
+        else if( same_word(key, "NAME") )
+        {
+            auto name = in.value();
+            instance_name.assign(name.first, name.second);
+        }
+        else if( same_word(key, "DIMENSION") )
+        {
+            in.skip_blanks();
+            if( in.pos < in.end && *in.pos == ':' ) ++in.pos;
+            if( !in.read_int(dimension) || dimension <= 0 ) parse_error(path, "invalid DIMENSION");
+            in.skip_line();
+        }
+        else if( same_word(key, "CAPACITY") )
+        {
+            in.skip_blanks();
+            if( in.pos < in.end && *in.pos == ':' ) ++in.pos;
+            if( !in.read_int(uniform_vehicle_capacity) ) parse_error(path, "invalid CAPACITY");
+            in.skip_line();
+        }
+        else if( same_word(key, "EDGE_WEIGHT_TYPE") )
+        {
+            auto type = in.value();
+            if( !same_word(type, "EUC_2D") ) cerr << path << ": EDGE_WEIGHT_TYPE " << string(type.first, type.second) << " is read as EUC_2D" << endl;
+        }
+        else if( same_word(key, "NODE_COORD_SECTION") || same_word(key, "DEMAND_SECTION") )
+        {
+            if( dimension <= 0 ) parse_error(path, "DIMENSION must come before the data sections");
+            bool coordinates = same_word(key, "NODE_COORD_SECTION");
+            in.skip_line();
+            if( coordinates ) points.assign(dimension, make_pair(0, 0));
+            else demands.assign(dimension, 0);
+            for(int node = 0; node < dimension; ++node)
+            {
+                int id, x, y;
+                if( !in.read_int(id) || id < 1 || id > dimension ) parse_error(path, "invalid node id in " + string(key.first, key.second));
+                if( coordinates )
+                {
+                    if( !in.read_int(x) || !in.read_int(y) ) parse_error(path, "invalid coordinates of node " + to_string(id));
+                    points[id - 1] = make_pair(x, y);
+                }
+                else if( !in.read_int(demands[id - 1]) ) parse_error(path, "invalid demand of node " + to_string(id));
+            }
+            (coordinates ? has_coordinates : has_demands) = true;
+            in.skip_line();
+        }
+        else if( same_word(key, "DEPOT_SECTION") )
+        {
+            in.skip_line();
+            while( in.read_int(value) && value != -1 )
+                if( depot_index < 0 ) depot_index = value - 1;
+            in.skip_line();
+        }
+        else in.skip_line(); // COMMENT, TYPE and any other keyword
+    }
+    munmap(mapped, file_size);
+
+    if( !has_coordinates ) parse_error(path, "missing NODE_COORD_SECTION");
+    if( !has_demands ) parse_error(path, "missing DEMAND_SECTION");
+    if( uniform_vehicle_capacity <= 0 ) parse_error(path, "missing CAPACITY");
+    if( depot_index < 0 || depot_index >= dimension ) depot_index = 0;
+}
+
+void instance::parse_file_legacy( const string& path )
+{
+    ifstream in(path);
     string line;
     vector< vector<string> > file_lines;
 
@@ -49,6 +238,8 @@ instance::instance( string _path_to_instance )
     dimension = stoi(file_lines[3][2]);
     uniform_vehicle_capacity = stoi( file_lines[5][2] );
 
+    points.clear();
+    demands.clear();
     constexpr int graphdata_start = 7;
         
     for(int node = 0; node < dimension; ++node)
@@ -66,9 +257,21 @@ instance::instance( string _path_to_instance )
     }
     
     depot_index = stoi(file_lines[demand_start + dimension + 1][0]) - 1;
-    
-    initialize_adjacency_matrix();
 }
 
 instance::instance() {}
 
+
+shared_ptr<const instance> load_shared_instance( const string& path_to_instance )
+{
+    static mutex registry_mutex;
+    static map< string, weak_ptr<const instance> > registry;
+    lock_guard<mutex> lock(registry_mutex);
+    shared_ptr<const instance> loaded = registry[path_to_instance].lock();
+    if( !loaded )
+    {
+        loaded = make_shared<const instance>(path_to_instance);
+        registry[path_to_instance] = loaded;
+    }
+    return loaded;
+}
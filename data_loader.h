@@ -10,26 +10,51 @@
 #include <utility>
 #include <iterator>
 #include <fstream>
+#include <memory>
+#include "distance_matrix.h"
+#include "spatial_index.h"
 
 using namespace std;
 
+// Default size of the granular neighbor lists built when an instance is loaded
+constexpr int DEFAULT_NEIGHBOR_LIST_SIZE = 20;
+// Memory allowed for the distance matrix before falling back to smaller storage modes
+constexpr size_t DEFAULT_DISTANCE_MEMORY_BUDGET = 256u << 20;
+
 struct instance 
 {
     vector< pair<int, int> > points;
     vector<int> demands;
-    vector< vector<int> > adjacency_matrix;
+    distance_matrix distances;
+    // nearest_neighbors[v] holds the customers closest to v, closest first (the depot is never included)
+    vector< vector<int> > nearest_neighbors;
+    // Grid over the points for nearest / range queries without an O(n) scan, built at load
+    spatial_index points_index;
 
     string path_to_instance;
     string instance_name;
 
     int dimension, depot_index, uniform_vehicle_capacity;
     
-    void initialize_adjacency_matrix();
-
-    instance( string _path_to_instance );
+    // Memory-mapped single pass parser: keyword driven TSPLIB header in any order, no allocation per number
+    void parse_file( const string& path );
+    // Original line based parser (fixed header layout), kept to compare against in the benchmark
+    void parse_file_legacy( const string& path );
+    void initialize_distances( size_t memory_budget );
+    void initialize_spatial_index();
+    // k nearest customers of every point through points_index, O(n k) on average
+    void initialize_neighbor_lists( int k );
+    // Original O(n^2 log k) construction, kept to compare against in the benchmark
+    void initialize_neighbor_lists_legacy( int k );
+
+    instance( string _path_to_instance, int neighbor_list_size = DEFAULT_NEIGHBOR_LIST_SIZE, size_t distance_memory_budget = DEFAULT_DISTANCE_MEMORY_BUDGET );
 
     instance();
 
 };
 
+// Loads an instance once per process: every caller asking for the same path while a
+// previous copy is alive gets the same immutable object (and the same distance matrix)
+shared_ptr<const instance> load_shared_instance( const string& path_to_instance );
+
 #endif
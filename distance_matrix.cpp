@@ -0,0 +1,46 @@
+#include "distance_matrix.h"
+
+distance_matrix::storage_mode distance_matrix::choose_mode( int dimension, size_t memory_budget )
+{
+    size_t dense_bytes = (size_t) dimension * dimension * sizeof(int);
+    size_t triangular_bytes = (size_t) dimension * (dimension - 1) / 2 * sizeof(int);
+    if( dense_bytes <= memory_budget ) return DENSE;
+    if( triangular_bytes <= memory_budget ) return TRIANGULAR;
+    return LAZY;
+}
+
+void distance_matrix::build( const vector< pair<int, int> >& points, storage_mode _mode )
+{
+    mode = _mode;
+    n = (int) points.size();
+    entries.clear();
+    coordinates.clear();
+    if( mode == DENSE )
+    {
+        entries.assign((size_t) n * n, 0);
+        for(int i = 0; i < n; ++i)
+        {
+            for(int j = i + 1; j < n; ++j)
+            {
+                entries[(size_t) i * n + j] = entries[(size_t) j * n + i] = euclidean_distance(points[i], points[j]);
+            }
+        }
+    }
+    else if( mode == TRIANGULAR )
+    {
+        entries.resize((size_t) n * (n - 1) / 2);
+        size_t k = 0;
+        for(int i = 1; i < n; ++i)
+            for(int j = 0; j < i; ++j)
+                entries[k++] = euclidean_distance(points[i], points[j]);
+    }
+    else coordinates = points;
+    entries.shrink_to_fit();
+}
+
+const char* distance_matrix::mode_name() const
+{
+    if( mode == DENSE ) return "dense";
+    if( mode == TRIANGULAR ) return "triangular";
+    return "lazy";
+}
@@ -0,0 +1,60 @@
+#ifndef DISTANCE_MATRIX_H
+#define DISTANCE_MATRIX_H
+
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <cstddef>
+
+using namespace std;
+
+// Rounded up euclidean distance (EUC_2D as used by the X instances)
+inline int euclidean_distance( const pair<int, int>& a, const pair<int, int>& b )
+{
+    long long dx = (long long) (a.first - b.first) * (a.first - b.first);
+    long long dy = (long long) (a.second - b.second) * (a.second - b.second);
+    return (int) ceil( sqrt( (double) (dx + dy) ) );
+}
+
+/*
+ * Symmetric distance matrix stored in a single contiguous block.
+ * DENSE      - n * n row-major entries, fastest access
+ * TRIANGULAR - only the n * (n - 1) / 2 entries below the diagonal
+ * LAZY       - nothing is stored, distances are computed from the points on demand
+ * The diagonal is always 0.
+ */
+struct distance_matrix
+{
+    enum storage_mode { DENSE, TRIANGULAR, LAZY };
+
+    storage_mode mode;
+    int n;
+    vector<int> entries;
+    vector< pair<int, int> > coordinates; // only kept by the lazy mode
+
+    // Picks the fastest mode whose storage fits in memory_budget bytes
+    static storage_mode choose_mode( int dimension, size_t memory_budget );
+
+    void build( const vector< pair<int, int> >& points, storage_mode _mode );
+    size_t memory_usage() const { return entries.size() * sizeof(int); }
+    const char* mode_name() const;
+
+    inline int dist( int i, int j ) const
+    {
+        if( mode == DENSE ) return entries[(size_t) i * n + j];
+        if( mode == TRIANGULAR )
+        {
+            if( i == j ) return 0;
+            if( i < j ) swap(i, j);
+            return entries[(size_t) i * (i - 1) / 2 + j];
+        }
+        return ( i == j ? 0 : euclidean_distance( coordinates[i], coordinates[j] ) );
+    }
+
+    // Row i of a DENSE matrix, contiguous (used by the vectorized gain kernels)
+    const int* row( int i ) const { return entries.data() + (size_t) i * n; }
+
+    distance_matrix() : mode(DENSE), n(0) {}
+};
+
+#endif
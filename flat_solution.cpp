@@ -0,0 +1,174 @@
+#include "flat_solution.h"
+
+flat_solution::flat_solution( shared_ptr<const instance> inst ) : data_inst(inst), total_cost(0) {}
+
+flat_solution::flat_solution() : total_cost(0) {}
+
+void flat_solution::from_routes( const vector< vector<int> >& routes )
+{
+    const instance& inst = *data_inst;
+    int total = (int) routes.size();
+    next.assign(inst.dimension, inst.depot_index);
+    prev.assign(inst.dimension, inst.depot_index);
+    route_of.assign(inst.dimension, -1);
+    pos_in_route.assign(inst.dimension, 0);
+    route_first.assign(total, -1);
+    route_last.assign(total, -1);
+    route_size.assign(total, 0);
+    route_load.assign(total, 0);
+    route_cost.assign(total, 0);
+    positions_dirty.assign(total, 0);
+    total_cost = 0;
+    for(int r = 0; r < total; ++r)
+    {
+        int previous = inst.depot_index;
+        for(int i = 1; i < (int) routes[r].size(); ++i)
+        {
+            int customer = routes[r][i];
+            link(previous, customer, r);
+            route_of[customer] = r;
+            pos_in_route[customer] = i;
+            route_load[r] += inst.demands[customer];
+            route_cost[r] += inst.distances.dist(previous, customer);
+            previous = customer;
+        }
+        link(previous, inst.depot_index, r);
+        route_cost[r] += inst.distances.dist(previous, inst.depot_index);
+        route_size[r] = (int) routes[r].size() - 1;
+        total_cost += route_cost[r];
+    }
+}
+
+void flat_solution::to_routes( vector< vector<int> >& routes, vector<int>& route_capacities ) const
+{
+    routes.clear();
+    route_capacities.clear();
+    for(int r = 0; r < total_routes(); ++r)
+    {
+        if( route_size[r] == 0 ) continue;
+        routes.emplace_back(1, data_inst->depot_index);
+        routes.back().reserve(route_size[r] + 1);
+        for(int c = route_first[r]; c != data_inst->depot_index; c = next[c]) routes.back().push_back(c);
+        route_capacities.push_back(route_load[r]);
+    }
+}
+
+void flat_solution::link( int from, int to, int route )
+{
+    const int depot = data_inst->depot_index;
+    if( from == depot ) route_first[route] = ( to == depot ? -1 : to );
+    else next[from] = to;
+    if( to == depot ) route_last[route] = ( from == depot ? -1 : from );
+    else prev[to] = from;
+}
+
+void flat_solution::renumber( int route )
+{
+    int i = 1;
+    for(int c = route_first[route]; c != -1 && c != data_inst->depot_index; c = next[c]) pos_in_route[c] = i++;
+    positions_dirty[route] = 0;
+}
+
+int flat_solution::position( int customer )
+{
+    if( positions_dirty[route_of[customer]] ) renumber(route_of[customer]);
+    return pos_in_route[customer];
+}
+
+bool flat_solution::relocate_feasible( int customer, int route ) const
+{
+    return route_of[customer] == route || route_load[route] + data_inst->demands[customer] <= data_inst->uniform_vehicle_capacity;
+}
+
+int flat_solution::relocate_delta( int customer, int route, int after ) const
+{
+    const distance_matrix& d = data_inst->distances;
+    const int depot = data_inst->depot_index;
+    int successor = ( after == depot ? ( route_first[route] == -1 ? depot : route_first[route] ) : next[after] );
+    if( successor == customer || after == customer ) return 0; // already there
+    int p = prev[customer], n = next[customer];
+    int removal = d.dist(p, n) - d.dist(p, customer) - d.dist(customer, n);
+    int insertion = d.dist(after, customer) + d.dist(customer, successor) - d.dist(after, successor);
+    return removal + insertion;
+}
+
+void flat_solution::relocate( int customer, int route, int after )
+{
+    const distance_matrix& d = data_inst->distances;
+    const int depot = data_inst->depot_index;
+    int successor = ( after == depot ? ( route_first[route] == -1 ? depot : route_first[route] ) : next[after] );
+    if( successor == customer || after == customer ) return;
+    int p = prev[customer], n = next[customer], from = route_of[customer];
+    int removal = d.dist(p, n) - d.dist(p, customer) - d.dist(customer, n);
+    int insertion = d.dist(after, customer) + d.dist(customer, successor) - d.dist(after, successor);
+
+    link(p, n, from);
+    link(after, customer, route);
+    link(customer, successor, route);
+    route_of[customer] = route;
+
+    route_cost[from] += removal;
+    route_cost[route] += insertion;
+    total_cost += removal + insertion;
+    route_size[from]--;
+    route_size[route]++;
+    route_load[from] -= data_inst->demands[customer];
+    route_load[route] += data_inst->demands[customer];
+    positions_dirty[from] = positions_dirty[route] = 1;
+}
+
+bool flat_solution::exchange_feasible( int a, int b ) const
+{
+    int ra = route_of[a], rb = route_of[b];
+    if( ra == rb ) return true;
+    int diff = data_inst->demands[b] - data_inst->demands[a];
+    return route_load[ra] + diff <= data_inst->uniform_vehicle_capacity && route_load[rb] - diff <= data_inst->uniform_vehicle_capacity;
+}
+
+int flat_solution::exchange_delta( int a, int b ) const
+{
+    if( a == b ) return 0;
+    const distance_matrix& d = data_inst->distances;
+    if( next[b] == a ) swap(a, b);
+    int pa = prev[a], na = next[a], pb = prev[b], nb = next[b];
+    // adjacent customers: pa -> a -> b -> nb becomes pa -> b -> a -> nb
+    if( na == b ) return d.dist(pa, b) + d.dist(b, a) + d.dist(a, nb) - d.dist(pa, a) - d.dist(a, b) - d.dist(b, nb);
+    return d.dist(pa, b) + d.dist(b, na) + d.dist(pb, a) + d.dist(a, nb)
+         - d.dist(pa, a) - d.dist(a, na) - d.dist(pb, b) - d.dist(b, nb);
+}
+
+void flat_solution::exchange( int a, int b )
+{
+    if( a == b ) return;
+    const distance_matrix& d = data_inst->distances;
+    if( next[b] == a ) swap(a, b);
+    int pa = prev[a], na = next[a], pb = prev[b], nb = next[b];
+    int ra = route_of[a], rb = route_of[b];
+    if( na == b )
+    {
+        int delta = exchange_delta(a, b);
+        route_cost[ra] += delta;
+        total_cost += delta;
+        link(pa, b, ra);
+        link(b, a, ra);
+        link(a, nb, ra);
+    }
+    else
+    {
+        int delta_a = d.dist(pa, b) + d.dist(b, na) - d.dist(pa, a) - d.dist(a, na);
+        int delta_b = d.dist(pb, a) + d.dist(a, nb) - d.dist(pb, b) - d.dist(b, nb);
+        route_cost[ra] += delta_a;
+        route_cost[rb] += delta_b;
+        total_cost += delta_a + delta_b;
+        link(pa, b, ra);
+        link(b, na, ra);
+        link(pb, a, rb);
+        link(a, nb, rb);
+    }
+    int diff = data_inst->demands[b] - data_inst->demands[a];
+    route_load[ra] += diff;
+    route_load[rb] -= diff;
+    route_of[a] = rb;
+    route_of[b] = ra;
+    swap(pos_in_route[a], pos_in_route[b]);
+}
@@ -0,0 +1,54 @@
+#ifndef FLAT_SOLUTION_H
+#define FLAT_SOLUTION_H
+
+#include <vector>
+#include <memory>
+#include "data_loader.h"
+
+using namespace std;
+
+/*
+ * Solution stored as doubly linked routes in contiguous arrays.
+ * Per node: next, prev and route_of (the depot closes every route, so next[last] = prev[first] = depot_index).
+ * Per route: first and last customer (-1 when empty), size, load and cost.
+ * Relocate and exchange are committed in O(1) and keep the caches exact; routes emptied by a
+ * relocate stay in place (empty) so route indices never shift. Positions inside a route are
+ * only needed by the nested format, so they are renumbered lazily, one route at a time.
+ */
+struct flat_solution
+{
+    shared_ptr<const instance> data_inst;
+
+    vector<int> next, prev, route_of;
+    vector<int> route_first, route_last, route_size, route_load, route_cost;
+    int total_cost;
+
+    vector<int> pos_in_route;    // valid for the routes whose positions_dirty flag is off
+    vector<char> positions_dirty;
+
+    void from_routes( const vector< vector<int> >& routes );
+    // Nested format (depot at index 0, empty routes skipped) for print_solution and the CSV writers
+    void to_routes( vector< vector<int> >& routes, vector<int>& route_capacities ) const;
+
+    int total_routes() const { return (int) route_first.size(); }
+    // 1-based position of a customer in its route, as in the nested format
+    int position( int customer );
+
+    // Moving customer to route, right after node after (depot_index = first of the route)
+    bool relocate_feasible( int customer, int route ) const;
+    int relocate_delta( int customer, int route, int after ) const;
+    void relocate( int customer, int route, int after );
+
+    bool exchange_feasible( int a, int b ) const;
+    int exchange_delta( int a, int b ) const;
+    void exchange( int a, int b );
+
+    // from -> to inside route (either end may be the depot)
+    void link( int from, int to, int route );
+    void renumber( int route );
+
+    flat_solution( shared_ptr<const instance> inst );
+    flat_solution();
+};
+
+#endif
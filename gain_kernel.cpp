@@ -0,0 +1,223 @@
+#include "gain_kernel.h"
+#include <immintrin.h>
+#include <algorithm>
+
+void route_block::load_routes( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst )
+{
+    begin.clear();
+    load_from(routes, route_capacities, data_inst, 0);
+}
+
+void route_block::reload_routes( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int route1, int route2 )
+{
+    // a route that changed size shifts every position after it
+    if( begin[route1 + 1] - begin[route1] != (int) routes[route1].size() || begin[route2 + 1] - begin[route2] != (int) routes[route2].size() )
+    {
+        load_from(routes, route_capacities, data_inst, min(route1, route2));
+        return;
+    }
+    rewrite_route(routes, route_capacities, data_inst, route1);
+    if( route2 != route1 ) rewrite_route(routes, route_capacities, data_inst, route2);
+}
+
+void route_block::load_from( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int first_route )
+{
+    int first = ( first_route == 0 ? 0 : begin[first_route] );
+    nodes.resize(first);
+    load.resize(first);
+    route.resize(first);
+    begin.resize(first_route);
+    for(int r = first_route; r < (int) routes.size(); ++r)
+    {
+        begin.push_back((int) nodes.size());
+        for(int i = 0; i < (int) routes[r].size(); ++i)
+        {
+            nodes.push_back(routes[r][i]);
+            load.push_back(i == 0 ? BLOCKED_LOAD : route_capacities[r]);
+            route.push_back(r);
+        }
+    }
+    begin.push_back((int) nodes.size());
+    nodes.push_back(data_inst.depot_index);
+    load.push_back(BLOCKED_LOAD);
+    route.push_back((int) routes.size());
+
+    // edge[first] joins the unchanged previous route to the depot, so it keeps its value
+    const distance_matrix& d = data_inst.distances;
+    int total = (int) nodes.size();
+    edge.resize(total + 1);
+    removal.resize(total);
+    demand.resize(total);
+    edge[0] = 0;
+    edge[total] = 0;
+    for(int i = max(first, 1); i < total; ++i) edge[i] = d.dist(nodes[i - 1], nodes[i]);
+    for(int i = first; i < total; ++i)
+    {
+        removal[i] = edge[i] + edge[i + 1];
+        demand[i] = data_inst.demands[nodes[i]];
+    }
+}
+
+void route_block::rewrite_route( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int r )
+{
+    const distance_matrix& d = data_inst.distances;
+    int first = begin[r], last = begin[r + 1]; // last: depot of the next route
+    for(int i = 0; i < (int) routes[r].size(); ++i)
+    {
+        nodes[first + i] = routes[r][i];
+        load[first + i] = ( i == 0 ? BLOCKED_LOAD : route_capacities[r] );
+        demand[first + i] = data_inst.demands[routes[r][i]];
+    }
+    for(int i = first + 1; i <= last; ++i) edge[i] = d.dist(nodes[i - 1], nodes[i]);
+    for(int i = first; i <= last; ++i) removal[i] = edge[i] + edge[i + 1];
+}
+
+int best_insertion_gain_scalar( const route_block& block, int from, int to, const int* row_c, int max_load, int& best_index )
+{
+    const int* nodes = block.nodes.data();
+    const int* edge = block.edge.data();
+    const int* load = block.load.data();
+    int best = NO_GAIN;
+    best_index = -1;
+    for(int i = from; i < to; ++i)
+    {
+        int gain = edge[i] - row_c[nodes[i - 1]] - row_c[nodes[i]];
+        if( load[i] <= max_load && gain > best ) { best = gain; best_index = i; }
+    }
+    return best;
+}
+
+int best_exchange_gain_scalar( const route_block& block, int from, int to, const int* row_prev, const int* row_next, const int* row_c, int max_demand, int max_rest, int& best_index )
+{
+    const int* nodes = block.nodes.data();
+    const int* demand = block.demand.data();
+    const int* load = block.load.data();
+    int best = NO_GAIN;
+    best_index = -1;
+    for(int j = from; j < to; ++j)
+    {
+        if( demand[j] > max_demand || load[j] - demand[j] > max_rest ) continue;
+        int gain = block.removal[j] - row_prev[nodes[j]] - row_next[nodes[j]] - row_c[nodes[j - 1]] - row_c[nodes[j + 1]];
+        if( gain > best ) { best = gain; best_index = j; }
+    }
+    return best;
+}
+
+// Best lane of (best, best_index): largest gain, smallest position among equal gains
+__attribute__((target("avx2"))) inline int reduce_lanes( __m256i best, __m256i best_index, int& index )
+{
+    __m256i top = _mm256_max_epi32(best, _mm256_permute2x128_si256(best, best, 1));
+    top = _mm256_max_epi32(top, _mm256_shuffle_epi32(top, _MM_SHUFFLE(1, 0, 3, 2)));
+    top = _mm256_max_epi32(top, _mm256_shuffle_epi32(top, _MM_SHUFFLE(2, 3, 0, 1)));
+    // unused lanes keep index -1, seen as the largest unsigned value by the min below
+    __m256i candidates = _mm256_or_si256(best_index, _mm256_xor_si256(_mm256_cmpeq_epi32(best, top), _mm256_set1_epi32(-1)));
+    __m256i first = _mm256_min_epu32(candidates, _mm256_permute2x128_si256(candidates, candidates, 1));
+    first = _mm256_min_epu32(first, _mm256_shuffle_epi32(first, _MM_SHUFFLE(1, 0, 3, 2)));
+    first = _mm256_min_epu32(first, _mm256_shuffle_epi32(first, _MM_SHUFFLE(2, 3, 0, 1)));
+    index = _mm256_cvtsi256_si32(first);
+    return ( index < 0 ? NO_GAIN : _mm256_cvtsi256_si32(top) );
+}
+
+__attribute__((target("avx2"))) int best_insertion_gain_avx2( const route_block& block, int from, int to, const int* row_c, int max_load, int& best_index )
+{
+    if( to - from < 8 ) return best_insertion_gain_scalar(block, from, to, row_c, max_load, best_index);
+    const int* nodes = block.nodes.data();
+    const int* edge = block.edge.data();
+    const int* load = block.load.data();
+    __m256i best = _mm256_set1_epi32(NO_GAIN), best_idx = _mm256_set1_epi32(-1);
+    __m256i positions = _mm256_add_epi32(_mm256_set1_epi32(from), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i step = _mm256_set1_epi32(8), load_limit = _mm256_set1_epi32(max_load + 1);
+    int i = from;
+    for(; i + 8 <= to; i += 8)
+    {
+        __m256i feasible = _mm256_cmpgt_epi32(load_limit, _mm256_loadu_si256((const __m256i*) (load + i)));
+        __m256i to_prev = _mm256_i32gather_epi32(row_c, _mm256_loadu_si256((const __m256i*) (nodes + i - 1)), 4);
+        __m256i to_cur = _mm256_i32gather_epi32(row_c, _mm256_loadu_si256((const __m256i*) (nodes + i)), 4);
+        __m256i gain = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*) (edge + i)), to_prev), to_cur);
+        __m256i better = _mm256_and_si256(feasible, _mm256_cmpgt_epi32(gain, best));
+        best = _mm256_blendv_epi8(best, gain, better);
+        best_idx = _mm256_blendv_epi8(best_idx, positions, better);
+        positions = _mm256_add_epi32(positions, step);
+    }
+    int result = reduce_lanes(best, best_idx, best_index);
+    for(; i < to; ++i)
+    {
+        int gain = edge[i] - row_c[nodes[i - 1]] - row_c[nodes[i]];
+        if( load[i] <= max_load && gain > result ) { result = gain; best_index = i; }
+    }
+    return result;
+}
+
+__attribute__((target("avx2"))) int best_exchange_gain_avx2( const route_block& block, int from, int to, const int* row_prev, const int* row_next, const int* row_c, int max_demand, int max_rest, int& best_index )
+{
+    if( to - from < 8 ) return best_exchange_gain_scalar(block, from, to, row_prev, row_next, row_c, max_demand, max_rest, best_index);
+    const int* nodes = block.nodes.data();
+    const int* removal = block.removal.data();
+    const int* demand = block.demand.data();
+    const int* load = block.load.data();
+    __m256i best = _mm256_set1_epi32(NO_GAIN), best_idx = _mm256_set1_epi32(-1);
+    __m256i positions = _mm256_add_epi32(_mm256_set1_epi32(from), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i step = _mm256_set1_epi32(8);
+    const __m256i demand_limit = _mm256_set1_epi32(max_demand + 1), rest_limit = _mm256_set1_epi32(max_rest + 1);
+    int j = from;
+    for(; j + 8 <= to; j += 8)
+    {
+        __m256i dem = _mm256_loadu_si256((const __m256i*) (demand + j));
+        __m256i rest = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*) (load + j)), dem);
+        __m256i feasible = _mm256_and_si256(_mm256_cmpgt_epi32(demand_limit, dem), _mm256_cmpgt_epi32(rest_limit, rest));
+        __m256i cur_nodes = _mm256_loadu_si256((const __m256i*) (nodes + j));
+        __m256i gain = _mm256_loadu_si256((const __m256i*) (removal + j));
+        gain = _mm256_sub_epi32(gain, _mm256_i32gather_epi32(row_prev, cur_nodes, 4));
+        gain = _mm256_sub_epi32(gain, _mm256_i32gather_epi32(row_next, cur_nodes, 4));
+        gain = _mm256_sub_epi32(gain, _mm256_i32gather_epi32(row_c, _mm256_loadu_si256((const __m256i*) (nodes + j - 1)), 4));
+        gain = _mm256_sub_epi32(gain, _mm256_i32gather_epi32(row_c, _mm256_loadu_si256((const __m256i*) (nodes + j + 1)), 4));
+        __m256i better = _mm256_and_si256(feasible, _mm256_cmpgt_epi32(gain, best));
+        best = _mm256_blendv_epi8(best, gain, better);
+        best_idx = _mm256_blendv_epi8(best_idx, positions, better);
+        positions = _mm256_add_epi32(positions, step);
+    }
+    int result = reduce_lanes(best, best_idx, best_index);
+    for(; j < to; ++j)
+    {
+        if( demand[j] > max_demand || load[j] - demand[j] > max_rest ) continue;
+        int gain = removal[j] - row_prev[nodes[j]] - row_next[nodes[j]] - row_c[nodes[j - 1]] - row_c[nodes[j + 1]];
+        if( gain > result ) { result = gain; best_index = j; }
+    }
+    return result;
+}
+
+bool avx2_supported()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+gain_kernel_isa current_kernel = ( avx2_supported() ? KERNEL_AVX2 : KERNEL_SCALAR );
+
+bool set_gain_kernel( gain_kernel_isa isa )
+{
+    if( isa == KERNEL_AVX2 && !avx2_supported() ) return false;
+    current_kernel = isa;
+    return true;
+}
+
+gain_kernel_isa active_gain_kernel() { return current_kernel; }
+
+const char* gain_kernel_name( gain_kernel_isa isa )
+{
+    if( isa == KERNEL_AVX2 ) return "avx2";
+    if( isa == KERNEL_SCALAR ) return "scalar";
+    return "off";
+}
+
+int best_insertion_gain( const route_block& block, int from, int to, const int* row_c, int max_load, int& best_index )
+{
+    if( current_kernel == KERNEL_AVX2 ) return best_insertion_gain_avx2(block, from, to, row_c, max_load, best_index);
+    return best_insertion_gain_scalar(block, from, to, row_c, max_load, best_index);
+}
+
+int best_exchange_gain( const route_block& block, int from, int to, const int* row_prev, const int* row_next, const int* row_c, int max_demand, int max_rest, int& best_index )
+{
+    if( current_kernel == KERNEL_AVX2 ) return best_exchange_gain_avx2(block, from, to, row_prev, row_next, row_c, max_demand, max_rest, best_index);
+    return best_exchange_gain_scalar(block, from, to, row_prev, row_next, row_c, max_demand, max_rest, best_index);
+}
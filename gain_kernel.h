@@ -0,0 +1,65 @@
+#ifndef GAIN_KERNEL_H
+#define GAIN_KERNEL_H
+
+#include <vector>
+#include "data_loader.h"
+
+using namespace std;
+
+/*
+ * Kernels that score a whole block of positions in one call, used by the inner loops of the
+ * exchange and delete_and_insert scans when the distance matrix is DENSE.
+ * A route_block lays one or more routes out in contiguous arrays; the distances to the fixed
+ * customer come from its matrix row, so 8 positions cost one gather per term with AVX2, and
+ * capacities become masks instead of branches. The scalar kernel does the same arithmetic one
+ * position at a time. Both return the first best position, so they choose exactly the moves of
+ * the plain loops.
+ */
+enum gain_kernel_isa { KERNEL_OFF = 0, KERNEL_SCALAR = 1, KERNEL_AVX2 = 2 };
+
+// Sentinel gain of a block with no feasible position
+constexpr int NO_GAIN = -0x3f3f3f3f;
+
+/*
+ * Route r occupies positions begin[r] (its depot) .. begin[r + 1] - 1, and one more depot closes
+ * the last route, so nodes[i + 1] is always defined. Position i of the block is position
+ * i - begin[r] of the route in the nested format.
+ */
+struct route_block
+{
+    vector<int> nodes;   // depot, customers of route 0, depot, customers of route 1, ..., depot
+    vector<int> edge;    // edge[i] = d(nodes[i - 1], nodes[i]): at a depot, the closing edge of the previous route
+    vector<int> removal; // removal[i] = edge[i] + edge[i + 1]
+    vector<int> demand;  // demand of nodes[i]
+    vector<int> load;    // load of the route of position i, BLOCKED_LOAD at the depots
+    vector<int> route;   // route of position i
+    vector<int> begin;   // begin[r], plus the position of the closing depot
+
+    void load_routes( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst );
+    // Lays out again the two routes changed by a move: in place when both kept their length,
+    // otherwise from the first of them to the end of the block
+    void reload_routes( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int route1, int route2 );
+    // helpers of the two above: routes first_route.. appended again | route r written over itself
+    void load_from( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int first_route );
+    void rewrite_route( const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int r );
+};
+
+// Load given to the depot positions so they never pass a capacity mask
+constexpr int BLOCKED_LOAD = 0x3f3f3f3f;
+
+// max over from <= i < to with load[i] <= max_load of  edge[i] - row_c[nodes[i - 1]] - row_c[nodes[i]]
+// (gain of inserting c between nodes[i - 1] and nodes[i], without the removal of c)
+int best_insertion_gain( const route_block& block, int from, int to, const int* row_c, int max_load, int& best_index );
+
+// max over from <= j < to with demand[j] <= max_demand and load[j] - demand[j] <= max_rest of
+//   removal[j] - row_prev[nodes[j]] - row_next[nodes[j]] - row_c[nodes[j - 1]] - row_c[nodes[j + 1]]
+// (gain of exchanging c, between prev and next, with nodes[j], without the removal of c)
+int best_exchange_gain( const route_block& block, int from, int to, const int* row_prev, const int* row_next, const int* row_c, int max_demand, int max_rest, int& best_index );
+
+// Kernel used by the scans: AVX2 when the processor has it, KERNEL_OFF = the original loops.
+// Returns false (and keeps the current kernel) if the processor does not support isa.
+bool set_gain_kernel( gain_kernel_isa isa );
+gain_kernel_isa active_gain_kernel();
+const char* gain_kernel_name( gain_kernel_isa isa );
+
+#endif
@@ -0,0 +1,85 @@
+#include "giant_tour.h"
+
+/*
+ * Positions are 1-based: customer i is tour[i - 1].
+ * potential[j] is the cost of the best split of the first j customers and the last
+ * route of that split starts after position pred[j]. A route (i, j] costs
+ *     d(depot, c_i+1) + distance_prefix[j] - distance_prefix[i + 1] + d(c_j, depot)
+ * so potential[j] = min over feasible i of  value(i) + distance_prefix[j] + d(c_j, depot),
+ * value(i) = potential[i] + d(depot, c_i+1) - distance_prefix[i + 1].
+ * The feasible i form a window that only moves forward, whose minimum is kept in a
+ * monotone deque: O(n) overall.
+ */
+int split_decoder::decode( const vector<int>& tour, const instance& data_inst, vector<int>& route_begin )
+{
+    const distance_matrix& d = data_inst.distances;
+    const int depot = data_inst.depot_index;
+    const int n = (int) tour.size();
+    distance_prefix.resize(n + 1);
+    load_prefix.resize(n + 1);
+    potential.resize(n + 1);
+    pred.resize(n + 1);
+    window.resize(n + 1);
+
+    distance_prefix[0] = distance_prefix[1] = 0;
+    load_prefix[0] = 0;
+    for(int i = 1; i <= n; ++i)
+    {
+        if( i > 1 ) distance_prefix[i] = distance_prefix[i - 1] + d.dist(tour[i - 2], tour[i - 1]);
+        load_prefix[i] = load_prefix[i - 1] + data_inst.demands[tour[i - 1]];
+    }
+
+    auto value = [&] (int i) { return potential[i] + d.dist(depot, tour[i]) - distance_prefix[i + 1]; };
+
+    potential[0] = 0;
+    int head = 0, tail = 0; // window[head .. tail - 1]
+    for(int j = 1; j <= n; ++j)
+    {
+        // j - 1 enters the window; the candidates it beats can never be the minimum again
+        int entering = value(j - 1);
+        while( tail > head && value(window[tail - 1]) >= entering ) tail--;
+        window[tail++] = j - 1;
+        // route (front, j] over capacity; the last candidate is kept even if a single demand exceeds it
+        while( tail - head > 1 && load_prefix[j] - load_prefix[window[head]] > data_inst.uniform_vehicle_capacity ) head++;
+        int best = window[head];
+        potential[j] = value(best) + distance_prefix[j] + d.dist(tour[j - 1], depot);
+        pred[j] = best;
+    }
+
+    route_begin.clear();
+    for(int j = n; j > 0; j = pred[j]) route_begin.push_back(pred[j]);
+    reverse(route_begin.begin(), route_begin.end());
+    route_begin.push_back(n);
+    return potential[n];
+}
+
+int split_giant_tour( const vector<int>& tour, const instance& data_inst, vector<int>& route_begin )
+{
+    split_decoder decoder;
+    return decoder.decode(tour, data_inst, route_begin);
+}
+
+int split_giant_tour( const vector<int>& tour, const instance& data_inst, vector< vector<int> >& routes, vector<int>& route_capacities )
+{
+    vector<int> route_begin;
+    int cost = split_giant_tour(tour, data_inst, route_begin);
+    int total_routes = (int) route_begin.size() - 1;
+    routes.assign(total_routes, vector<int>(1, data_inst.depot_index));
+    route_capacities.assign(total_routes, 0);
+    for(int r = 0; r < total_routes; ++r)
+    {
+        for(int i = route_begin[r]; i < route_begin[r + 1]; ++i)
+        {
+            routes[r].push_back(tour[i]);
+            route_capacities[r] += data_inst.demands[tour[i]];
+        }
+    }
+    return cost;
+}
+
+vector<int> giant_tour_of( const vector< vector<int> >& routes )
+{
+    vector<int> tour;
+    for(const auto& route : routes) tour.insert(tour.end(), route.begin() + 1, route.end());
+    return tour;
+}
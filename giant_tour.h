@@ -0,0 +1,35 @@
+#ifndef GIANT_TOUR_H
+#define GIANT_TOUR_H
+
+#include <vector>
+#include "data_loader.h"
+
+using namespace std;
+
+/*
+ * Giant tour encoding: a single permutation of the customers (depot excluded).
+ * Any permutation is a solution once it is cut into capacity-feasible routes by Split,
+ * which finds the cheapest way to do so keeping the visiting order (Prins, 2004).
+ * Split runs in O(n) using the sliding window minimum of Vidal (2016).
+ *
+ * The decoded solution is also flat: route r visits tour[route_begin[r] .. route_begin[r + 1] - 1],
+ * and route_begin ends with tour.size().
+ */
+struct split_decoder
+{
+    // buffers indexed by tour position + 1, kept between calls so decoding does not allocate
+    vector<int> distance_prefix, load_prefix, potential, pred, window;
+
+    // Returns the cost of the optimal split and fills route_begin
+    int decode( const vector<int>& tour, const instance& data_inst, vector<int>& route_begin );
+};
+
+int split_giant_tour( const vector<int>& tour, const instance& data_inst, vector<int>& route_begin );
+
+// Split into the nested representation used by the solvers (depot at index 0 of every route)
+int split_giant_tour( const vector<int>& tour, const instance& data_inst, vector< vector<int> >& routes, vector<int>& route_capacities );
+
+// Giant tour visiting the routes one after the other
+vector<int> giant_tour_of( const vector< vector<int> >& routes );
+
+#endif
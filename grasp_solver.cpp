@@ -12,24 +12,27 @@
 #include "data_loader.h"
 #include "neighborhood_generator.h"
 #include "time_lib.h"
+#include "batch_runner.h"
+#include "giant_tour.h"
+#include "alloc_counter.h"
+#include "construction.h"
+#include "instrumentation.h"
+#include "solution_hash.h"
 #include <fstream>
-
-#define TRACE(x) 
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 constexpr int INF = 0x3f3f3f3f;
+constexpr int CONSTRUCTION_WINDOW = 8; // candidatos da lista restrita na construcao aleatorizada
+constexpr double SAVINGS_NOISE = 0.1; // perturbacao padrao das economias do Clarke-Wright entre reinicializacoes
+constexpr int KNOWN_OPTIMA_LOG2 = 16; // 2^16 otimos locais lembrados por execucao (ver solution_hash.h)
 
 using namespace std;
 
-inline int euclidean_distance( const pair<int, int>& a, const pair<int, int>& b)
-{
-    int dx = (a.first - b.first) * (a.first - b.first);
-    int dy = (a.second - b.second) * (a.second - b.second);
-    return (int) ceil( sqrt( dx + dy ) );
-}
-
 struct grasp_solver
 {
-    instance test_data; // Instancia que sera resolvida     
+    shared_ptr<const instance> test_data; // Instancia que sera resolvida, compartilhada entre solvers
     pair<int, int> center; // Posicao geografica do deposito
     int center_idx; // Indice do deposito
     neighborhood_generator n_generator; // gerador de vizinhanca para uma solucao 
@@ -39,93 +42,78 @@ struct grasp_solver
     
     vector< vector<int> > best_routes; 
     int best_routes_cost;
+    bool split_initial_tour = false; // smart_greedy corta o giant tour com o Split otimo
+    cost_evaluator evaluator; // custo das solucoes, compartilhado com o simulated annealing
+    sweep_constructor sweep; // ordem polar dos clientes, calculada uma vez
+    vector<int> tour_buffer; // giant tour da construcao, reaproveitado entre reinicializacoes
+    double construction_alpha = -1; // >= 0: construcao aleatorizada com lista restrita de candidatos
+    bool savings_initial = false; // solucao inicial pelo Clarke-Wright em vez do smart_greedy
+    savings_constructor savings; // lista de economias, calculada na primeira construcao
+    long long loop_allocations = 0; // alocacoes no ultimo laco de busca local (ver alloc_counter.h)
+    concurrent_hash_set* known_optima = nullptr; // hashes dos otimos locais ja encontrados, compartilhado entre workers
+    long long known_optimum_stops = 0; // descidas interrompidas por chegarem a um otimo conhecido
+    long long new_optima = 0; // otimos locais inseridos em known_optima por este solver
     
-    // Funcao que calcula o custo total de uma solucao, uma rota de cada vez 
+    // Funcao que calcula o custo total de uma solucao, uma rota de cada vez.
+    // As distancias vem da matriz da instancia e as rotas que nao mudaram desde a ultima
+    // avaliacao reaproveitam o custo guardado no evaluator
     int solution_cost(const vector< vector<int> >& routes)
     {
-        int total_cost = 0;
-        
-        auto cost_per_route = [&] ( const vector<int>& route )
-        {
-            int cost = 0;
-            
-            for(int i = 1; i < (int) route.size(); ++i)
-                cost += euclidean_distance( test_data.points[route[i]], test_data.points[route[i - 1] ] );
-            
-            cost += euclidean_distance( test_data.points[center_idx], test_data.points[route.back()] );
-            return cost;
-        };
-
-        for(const auto& R : routes) total_cost += cost_per_route( R ); 
-       
-        return total_cost;
+        return evaluator.solution_cost( routes );
     }
     
     /*
      * A funcao smart_greedy foi chave na obtencao de solucoes proximas do OPT
      * Nela realizamos os seguintes passos
      * 1 - Ordenamos os pontos por suas coordenadas geograficas, ordenando em relacao ao angulo que cada ponto faz com o deposito
-     * 2 - Realizarmos um shift circular nesse vetor ordenado. ( via funcao de c++ rotate )
+     * 2 - Realizarmos um shift circular nesse vetor ordenado.
      * 3 - Seguimos a ordem obtida, tentando sempre inserir o proximo elemento na ultima rota criada ate o momento. 
      *     Se nao for possivel atender a esse elemento por questoes de capacidade dos caminhoes, iniciamos uma nova rota que contem
      *     esse novo elemento.
+     * Os passos 1 e 2 formam um giant tour (smart_greedy_giant_tour). Com split_initial_tour = true, o passo 3
+     * e substituido pelo Split otimo (giant_tour.h), que corta o mesmo tour em rotas da forma mais barata.
+     * A ordenacao do passo 1 e feita uma unica vez, no construtor (construction.h); cada reinicializacao
+     * so sorteia o deslocamento do passo 2.
+     * Com construction_alpha >= 0 a construcao e a de um GRASP de verdade: o proximo cliente de cada rota
+     * e sorteado na lista restrita de candidatos (sweep_constructor::randomized_sweep).
      */
-    void smart_greedy()
+    const vector<int>& smart_greedy_giant_tour()
     {
-        cur_routes.clear();
-        cur_routes_capacities.clear();
+        int rot = ( n_generator.rng() % test_data->dimension );
+        sweep.rotated_tour( rot, tour_buffer );
+        return tour_buffer;
+    }
 
-        vector< vector<int> > routes(1, vector<int>(1, center_idx));
-        vector< int > route_demand(1, 0);
-        vector< tuple<int, int, int> > points;
-        for(int p = 0; p < test_data.dimension; ++p)
+    void smart_greedy()
+    {
+        if( construction_alpha >= 0 )
         {
-            if( p == test_data.depot_index ) continue;
-            points.emplace_back( test_data.points[p].first, test_data.points[p].second, p );
+            int rot = ( n_generator.rng() % test_data->dimension );
+            cur_routes_cost = sweep.randomized_sweep( rot, construction_alpha, CONSTRUCTION_WINDOW, n_generator.rng, cur_routes, cur_routes_capacities );
+            return;
         }
-        // Radial sort
-        sort( points.begin(), points.end(), [&] (tuple<int, int, int>& a, tuple<int, int, int>& b)
-        {
-            pair<int, int> pa = make_pair(get<0>(a) - center.first, get<1>(a) - center.second);
-            pair<int, int> pb = make_pair(get<0>(b) - center.first, get<1>(b) - center.second);
-            int cross_product = pa.first * pb.second - pa.second * pb.first;
-            if( cross_product != 0 ) return (cross_product > 0);
-            pa = make_pair(pa.first * pa.first, pa.second * pa.second );
-            pb = make_pair(pb.first * pb.first, pb.second * pb.second );
-            int len_a = pa.first + pa.second;
-            int len_b = pb.first + pb.second;
+        smart_greedy_giant_tour();
+        if( split_initial_tour ) cur_routes_cost = split_giant_tour( tour_buffer, *test_data, cur_routes, cur_routes_capacities );
+        else cur_routes_cost = sweep.sweep_routes( tour_buffer, cur_routes, cur_routes_capacities );
+    }
 
-            return len_a < len_b;
-        });
-        
-        int rot = ( rand() % test_data.dimension);
-        
-        // Shift circular do vetor ordenado radialmente
-        rotate(points.begin(), points.begin() + rot, points.end() );
-        int current_route = 0;
-        
-        for(const auto& P : points) 
+    /*
+     * Solucao inicial de cada reinicializacao: smart_greedy ou, com savings_initial, o Clarke-Wright
+     * (construction.h). Para que as reinicializacoes nao partam todas da mesma solucao, as economias
+     * sao perturbadas por um fator aleatorio em [1 - a, 1], com a = construction_alpha se ele foi
+     * dado e SAVINGS_NOISE caso contrario (construction_alpha = 0 e o Clarke-Wright puro).
+     */
+    void initial_solution()
+    {
+        INSTRUMENT( phase_timer timing(PHASE_CONSTRUCTION); )
+        if( !savings_initial )
         {
-            int point_index = get<2>(P);
-            if( test_data.demands[point_index] + route_demand[current_route] <= test_data.uniform_vehicle_capacity )
-            {
-                route_demand[current_route] += test_data.demands[point_index];
-                routes[current_route].push_back( point_index );
-            }
-            else
-            {
-                current_route++;
-                route_demand.push_back(0);
-                route_demand[current_route] += test_data.demands[point_index];
-                routes.push_back( vector<int>(1, center_idx) );
-                routes.back().push_back( point_index ); 
-            
-            }
+            smart_greedy();
+            return;
         }
-        
-        cur_routes = routes; 
-        cur_routes_capacities = route_demand; 
-        cur_routes_cost = solution_cost(cur_routes);
+        if( savings.data_inst == nullptr ) savings = savings_constructor( test_data.get() );
+        double noise = ( construction_alpha >= 0 ? construction_alpha : SAVINGS_NOISE );
+        cur_routes_cost = savings.build( cur_routes, cur_routes_capacities, noise, &n_generator.rng );
     }
    
     /* Essa versao do solver obedece a politica de first_improvement. 
@@ -135,99 +123,144 @@ struct grasp_solver
 
     vector< vector<int> > cvrp_solver_first_improvement(const int max_stall_iterations, vector<int>& neighborhood_set, int seed) 
     {
-        smart_greedy();
-        best_routes = cur_routes;
+        n_generator.set_seed(seed);
+        initial_solution();
+        INSTRUMENT( phase_timer timing(PHASE_LOCAL_SEARCH); )
+        // As rotas recebem a capacidade da maior rota viavel, entao os movimentos nao realocam
+        reserve_routes( cur_routes, *test_data );
+        // As cargas acumuladas das rotas sao mantidas pelo apply_move (checagem O(1) do 2-opt*)
+        n_generator.track_loads( cur_routes );
         best_routes_cost = cur_routes_cost;
         int cur_stall_iterations = 0;
-        
-        n_generator.set_seed(seed);
 
+        // So movimentos que melhoram sao aceitos, entao a solucao atual e sempre a melhor:
+        // ela e copiada uma unica vez, no final, e o laco nao faz nenhuma alocacao
+        long long allocations_before = allocation_count();
         while(cur_stall_iterations < max_stall_iterations)
         {
-            vector< vector<int> > updated_routes = cur_routes;
-            vector<int> updated_routes_capacities = cur_routes_capacities;
-            
-            n_generator.update_solution_custom(updated_routes, updated_routes_capacities, neighborhood_set);
+            // Avaliamos apenas o delta do movimento; as rotas so mudam se ele for aceito
+            move_proposal proposal = n_generator.propose_move_custom(cur_routes, cur_routes_capacities, neighborhood_set);
             
-            int new_cost = solution_cost(updated_routes);
-            int improvement = cur_routes_cost - new_cost;
-            
-            if( improvement > 0 )
+            if( proposal.delta < 0 )
             {
-                cur_routes = updated_routes;
-                cur_routes_capacities = updated_routes_capacities;
-                cur_routes_cost = new_cost;
+                n_generator.apply_move(cur_routes, cur_routes_capacities, proposal);
+                cur_routes_cost += proposal.delta;
                 cur_stall_iterations = 0;
-                best_routes = cur_routes;
                 best_routes_cost = cur_routes_cost;
             }
             else cur_stall_iterations++;
         }
+        loop_allocations = allocation_count() - allocations_before;
+        best_routes = cur_routes;
         return best_routes;
     }
 
     /* Essa versao do solver foi que obteve os melhores resultados.
      * Passos:
-     * 1 - Gerar solucao inicial via smart_greedy
+     * 1 - Gerar solucao inicial via smart_greedy (ou Clarke-Wright, ver initial_solution)
      * 2 - A cada step, selecionamos de forma equiprovável uma das seguintes vizinhancas ( delete_and_insert e exchange )
-     * 3 - Buscamos o melhor vizinho da vizinhanca escolhida no passo 2.
+     * 3 - Buscamos o melhor vizinho da vizinhanca escolhida no passo 2 (via move_cache, sem varrer tudo de novo).
      * 4 - Se esse vizinho é estritamente melhor que a solucao atual, atribuímos ele a nossa solução inicial
      * 5 - Se apos, max_stall_iterations nao obtivemos melhora a melhor solucao. Retornamos a melhor solucao encontrada
+     * Com known_optima, o hash da solucao atual (solution_hash.h) e atualizado a cada movimento aplicado.
+     * Um passo sem melhora numa solucao que ja e um otimo local conhecido encerra a descida: os passos
+     * seguintes tambem falhariam. So entram em known_optima as solucoes em que o cache confirma que
+     * nenhum exchange e nenhum delete_and_insert melhora, entao a parada e exata e o resultado nao muda.
      */
 
     vector< vector<int> > cvrp_solver_best_improvement(const int max_stall_iterations, int seed) 
     {
-        smart_greedy();
+        search_limits unlimited;
+        return cvrp_solver_best_improvement(max_stall_iterations, seed, unlimited);
+    }
+
+    // Mesma busca, interrompida quando limits (deadline ou custo alvo) e atingido
+    vector< vector<int> > cvrp_solver_best_improvement(const int max_stall_iterations, int seed, search_limits& limits) 
+    {
+        n_generator.set_seed(seed);
+        initial_solution();
+        INSTRUMENT( phase_timer timing(PHASE_LOCAL_SEARCH); )
+        // cur_routes mudou por inteiro: as posicoes dos clientes das listas granulares sao refeitas
+        if( n_generator.granular_neighbors > 0 ) n_generator.locate_cities( cur_routes );
         best_routes = cur_routes;
         best_routes_cost = cur_routes_cost;
         int cur_stall_iterations = 0;
-        
-        n_generator.set_seed(seed);
 
-        while(cur_stall_iterations < max_stall_iterations)
+        // Os melhores movimentos de cada par de rotas ficam em cache; so os pares das rotas
+        // alteradas sao reavaliados a cada passo (as listas granulares nao usam o cache, e com
+        // rotas muito curtas varrer tudo de novo sai mais barato)
+        bool cached = ( n_generator.granular_neighbors == 0 && use_move_cache( cur_routes ) );
+        move_cache cache;
+        if( cached ) cache.rebuild( cur_routes, cur_routes_capacities, *test_data );
+        bool hashed = ( cached && known_optima != nullptr );
+        uint64_t cur_hash = ( hashed ? solution_hash( cur_routes, center_idx ) : 0 );
+
+        // Um passo sem melhora nao altera as rotas, entao a busca e feita direto na solucao atual,
+        // que e sempre a melhor encontrada
+        while(cur_stall_iterations < max_stall_iterations && !limits.should_stop(best_routes_cost))
         {
-            vector< vector<int> > updated_routes = cur_routes;
-            vector<int> updated_routes_capacities = cur_routes_capacities;
-            bool has_improved = n_generator.update_solution_best_improvement(updated_routes, updated_routes_capacities);
+            bool has_improved = ( cached ? n_generator.update_solution_best_improvement(cur_routes, cur_routes_capacities, cache, hashed ? &cur_hash : nullptr)
+                                         : n_generator.update_solution_best_improvement(cur_routes, cur_routes_capacities) );
             if( has_improved ) {
-                best_routes = updated_routes;
-                best_routes_cost = solution_cost( best_routes );
+                cur_routes_cost = solution_cost( cur_routes );
+                best_routes_cost = cur_routes_cost;
                 cur_stall_iterations = 0;
-                cur_routes = best_routes;
-                cur_routes_capacities = updated_routes_capacities;
-                cur_routes_cost = best_routes_cost;
             }
-            else cur_stall_iterations++; 
+            else {
+                if( hashed && known_optima->contains(cur_hash) ) {
+                    known_optimum_stops++;
+                    break;
+                }
+                cur_stall_iterations++; 
+            }
         }
+        if( hashed && cache.best(cur_routes, cur_routes_capacities, *test_data, EXCHANGE).delta >= 0 && cache.best(cur_routes, cur_routes_capacities, *test_data, DELETE_AND_INSERT).delta >= 0 && known_optima->insert(cur_hash) ) new_optima++;
+        best_routes = cur_routes;
         return best_routes;
     }
     
 
-    grasp_solver(instance _test_data )
+    grasp_solver(shared_ptr<const instance> _test_data )
     {
         test_data = _test_data;
-        center = test_data.points[test_data.depot_index];
-        center_idx = test_data.depot_index;
+        center = test_data->points[test_data->depot_index];
+        center_idx = test_data->depot_index;
         n_generator = neighborhood_generator(test_data);
+        evaluator = cost_evaluator(test_data.get());
+        sweep = sweep_constructor(test_data.get());
     }
     
     grasp_solver() {}
 
 };
 
+constexpr unsigned GRASP_SEED = 13; // Lucky seed (:
+
 // Funcao que chama o solver com parametros definidos
-int generate_solution( string instance_name, int allowed_iterations )
+// granular_neighbors > 0 restringe a busca local aos k vizinhos mais proximos de cada cliente
+// A semente da i-esima reinicializacao depende apenas de (GRASP_SEED, i), entao o resultado
+// e o mesmo de generate_solution_parallel para qualquer numero de threads
+// limits interrompe a busca por tempo (relogio de parede) ou ao atingir um custo alvo
+// split_initial_tour escolhe o Split otimo na construcao da solucao inicial
+// construction_alpha >= 0 usa a construcao aleatorizada com lista restrita de candidatos
+// savings_initial constroi a solucao inicial pelo Clarke-Wright
+// Com -DCVRP_INSTRUMENT, os contadores da execucao vao para traces/grasp_<instancia>_<iteracoes>.csv
+int generate_solution( string instance_name, int allowed_iterations, int granular_neighbors = 0, search_limits limits = search_limits(), bool split_initial_tour = false, double construction_alpha = -1, bool savings_initial = false )
 {
-    grasp_solver solver( instance_name );
+    grasp_solver solver( load_shared_instance(instance_name) );
+    solver.n_generator.set_granular( granular_neighbors );
+    solver.split_initial_tour = split_initial_tour;
+    solver.construction_alpha = construction_alpha;
+    solver.savings_initial = savings_initial;
+    concurrent_hash_set known_optima( KNOWN_OPTIMA_LOG2 );
+    solver.known_optima = &known_optima;
     int best_cost = INF;
     vector< vector<int> > best_solution_found;
+    INSTRUMENT( wall_timer run_timer; take_thread_counters(); )
     
-    srand(13); // Lucky seed (:
-    
-    for(int i = 0; i < allowed_iterations; ++i)
+    for(int i = 0; i < allowed_iterations && !limits.should_stop(best_cost); ++i)
     {
-        int s = rand();
-        auto solution = solver.cvrp_solver_best_improvement(10, s);
+        auto solution = solver.cvrp_solver_best_improvement(10, derive_seed(GRASP_SEED, i), limits);
         int solution_cost = solver.solution_cost( solution );
         if( solution_cost < best_cost ) 
         {
@@ -235,14 +268,160 @@ int generate_solution( string instance_name, int allowed_iterations )
             best_solution_found = solution;
         }
     }
+    INSTRUMENT( write_run_counters( "traces/grasp_" + instance_basename(instance_name) + "_" + to_string(allowed_iterations) + ".csv", take_thread_counters(), run_timer.elapsed_ms() ); )
     return best_cost;
 }
 
+/* Versao paralela do GRASP.
+ * As reinicializacoes sao distribuidas entre total_threads workers, que pegam o proximo indice
+ * de um contador atomico. Cada worker tem seu proprio grasp_solver (e portanto seu proprio gerador
+ * aleatorio), todos compartilhando a mesma instancia.
+ * O custo da melhor solucao e publicado em um incumbente atomico (sem locks). A melhor solucao de
+ * cada worker fica local e, no final, escolhemos a de menor (custo, indice da reinicializacao),
+ * o que torna o resultado deterministico para uma semente fixa.
+ */
+int generate_solution_parallel( string instance_name, int allowed_iterations, int total_threads, unsigned seed = GRASP_SEED, int granular_neighbors = 0, search_limits limits = search_limits(), bool split_initial_tour = false, double construction_alpha = -1, bool savings_initial = false )
+{
+    shared_ptr<const instance> inst = load_shared_instance(instance_name);
+    atomic<int> next_restart(0);
+    atomic<int> incumbent_cost(INF);
+    concurrent_hash_set known_optima( KNOWN_OPTIMA_LOG2 ); // um otimo achado por um worker encurta as descidas dos outros
+
+    struct worker_best { int cost = INF; int restart = INT_MAX; vector< vector<int> > routes; };
+    vector< worker_best > bests( max(1, total_threads) );
+    INSTRUMENT( wall_timer run_timer; vector< search_counters > worker_counters( bests.size() ); )
 
-int main()
+    auto worker = [&] (int id)
+    {
+        grasp_solver solver( inst );
+        solver.n_generator.set_granular( granular_neighbors );
+        solver.split_initial_tour = split_initial_tour;
+        solver.construction_alpha = construction_alpha;
+        solver.savings_initial = savings_initial;
+        solver.known_optima = &known_optima;
+        worker_best& mine = bests[id];
+        INSTRUMENT( take_thread_counters(); )
+        search_limits my_limits = limits; // cada worker le o relogio por conta propria
+        // o custo alvo e comparado com o incumbente, entao todos param quando qualquer um o atinge
+        for(int i = next_restart++; i < allowed_iterations && !my_limits.should_stop(incumbent_cost.load(memory_order_relaxed)); i = next_restart++)
+        {
+            auto solution = solver.cvrp_solver_best_improvement(10, derive_seed(seed, i), my_limits);
+            int cost = solver.solution_cost( solution );
+            if( cost < mine.cost || (cost == mine.cost && i < mine.restart) )
+            {
+                mine.cost = cost;
+                mine.restart = i;
+                mine.routes = solution;
+            }
+            // publica no incumbente global
+            int current = incumbent_cost.load(memory_order_relaxed);
+            while( cost < current && !incumbent_cost.compare_exchange_weak(current, cost, memory_order_relaxed) );
+        }
+        INSTRUMENT( worker_counters[id] = take_thread_counters(); )
+    };
+
+    vector< thread > pool;
+    for(int t = 1; t < (int) bests.size(); ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for(auto& th : pool) th.join();
+
+    const worker_best* best = &bests[0];
+    for(const auto& b : bests)
+        if( b.cost < best->cost || (b.cost == best->cost && b.restart < best->restart) ) best = &b;
+    INSTRUMENT(
+        cout << "melhor reinicializacao = " << best->restart << ", incumbente = " << incumbent_cost.load() << endl;
+        for(int t = 1; t < (int) worker_counters.size(); ++t) worker_counters[0].add( worker_counters[t] );
+        write_run_counters( "traces/grasp_" + instance_basename(instance_name) + "_" + to_string(allowed_iterations) + "_" + to_string(total_threads) + "threads.csv", worker_counters[0], run_timer.elapsed_ms() );
+    )
+    return best->cost;
+}
+
+
+/* Executa a grade de experimentos descrita em config_path (ver batch_runner.h).
+ * Cada celula (instancia, iteracoes) e um job independente; ate config.jobs rodam ao mesmo tempo,
+ * cada um limitado a config.time_budget_ms. Os CSVs tem as mesmas colunas da execucao padrao.
+ */
+void run_batch( const string& config_path )
 {
-    
-    instance first_instance("instances/X-n204-k19.vrp");
+    batch_config config = read_batch_config(config_path);
+    string output_dir = ( config.output_dir.empty() ? "grasp_results/" : config.output_dir );
+
+    struct cell { int instance_idx; int iterations; long double duration; int cost; };
+    vector< cell > cells;
+    for(int i = 0; i < (int) config.instances.size(); ++i)
+        for(int iter : config.iterations) cells.push_back( cell{ i, iter, 0, INF } );
+
+    vector< function<void()> > jobs;
+    for(cell& c : cells)
+    {
+        jobs.push_back( [&config, &c] ()
+        {
+            int target = ( config.target_gap >= 0 ? search_limits::target_from_gap(config.bks[c.instance_idx], config.target_gap) : -1 );
+            wall_timer timer;
+            c.cost = generate_solution( config.instances[c.instance_idx], c.iterations, 0, search_limits(config.time_budget_ms, target, 1) );
+            c.duration = timer.elapsed_ms();
+            printf("%s, %d iteracoes: %d (%.1Lf ms)\n", config.instances[c.instance_idx].c_str(), c.iterations, c.cost, c.duration);
+        });
+    }
+    run_jobs( jobs, config.jobs );
+
+    for(int i = 0; i < (int) config.instances.size(); ++i)
+    {
+        ofstream out_file( output_dir + instance_basename(config.instances[i]) + ".csv" );
+        out_file << "Total iteracoes,Tempo total(ms),Solucao encontrada,BKS,Approximation Ratio" << endl;
+        for(const cell& c : cells)
+        {
+            if( c.instance_idx != i ) continue;
+            out_file << c.iterations << "," << c.duration << "," << c.cost << "," << config.bks[i] << "," << (1.0 * c.cost / config.bks[i] ) << endl;
+        }
+        out_file.close();
+    }
+}
+
+/* Uso: ./GRASP_SOLVER [threads] [--time-limit ms] [--target-gap g] [--split] [--alpha a] [--savings] [--granular k]
+ *   threads > 1     executa as reinicializacoes em paralelo
+ *   --time-limit    limite de tempo (relogio de parede) de cada execucao
+ *   --target-gap    para ao encontrar uma solucao a no maximo g (ex.: 0.05) acima da BKS
+ *   --split         a solucao inicial corta o giant tour radial com o Split otimo
+ *   --alpha         construcao aleatorizada: lista restrita de candidatos com parametro a (0 = guloso, 1 = aleatorio)
+ *   --savings       a solucao inicial e a do Clarke-Wright (com --alpha, a perturbacao das economias)
+ *   --granular      busca local granular: so os k vizinhos mais proximos de cada cliente (ate
+ *                   DEFAULT_NEIGHBOR_LIST_SIZE; 0 = varredura completa com o cache de movimentos)
+ *      ./GRASP_SOLVER --batch <config>    (grade de experimentos lida de um arquivo, ver batch_grasp.cfg)
+ */
+int main(int argc, char** argv)
+{
+    int total_threads = 1;
+    long double time_limit_ms = 0;
+    double target_gap = -1;
+    bool split_initial_tour = false;
+    double construction_alpha = -1;
+    bool savings_initial = false;
+    int granular_neighbors = 0;
+    for(int a = 1; a < argc; ++a)
+    {
+        string arg = argv[a];
+        if( arg == "--batch" && a + 1 < argc )
+        {
+            run_batch( argv[a + 1] );
+            return 0;
+        }
+        else if( arg == "--time-limit" && a + 1 < argc ) time_limit_ms = atof( argv[++a] );
+        else if( arg == "--target-gap" && a + 1 < argc ) target_gap = atof( argv[++a] );
+        else if( arg == "--split" ) split_initial_tour = true;
+        else if( arg == "--alpha" && a + 1 < argc ) construction_alpha = atof( argv[++a] );
+        else if( arg == "--savings" ) savings_initial = true;
+        else if( arg == "--granular" && a + 1 < argc ) granular_neighbors = max(0, atoi( argv[++a] ));
+        else if( !arg.empty() && arg.find_first_not_of("0123456789") == string::npos ) total_threads = max(1, atoi( argv[a] ));
+        else
+        {
+            // opcoes desconhecidas (ou sem o valor) nao sao ignoradas
+            cerr << "Opcao invalida: " << arg << endl;
+            cerr << "Uso: ./GRASP_SOLVER [threads] [--time-limit ms] [--target-gap g] [--split] [--alpha a] [--savings] [--granular k]" << endl;
+            cerr << "     ./GRASP_SOLVER --batch <config>" << endl;
+            return 1;
+        }
+    }
     string instance_prefix = "instances/";
     string csv_prefix = "grasp_results/";
     vector< string > instances = { "X-n101-k25.vrp", "X-n110-k13.vrp", "X-n115-k10.vrp", "X-n204-k19.vrp" };
@@ -262,10 +441,10 @@ int main()
         for(const int iter : iterations )
         {
             cout << "rodando para uma quantidade de iteracoes = " << iter << endl;
-            clock_t start = get_time();
-            int solution_cost = generate_solution( instance_name, iter );
-            clock_t end   = get_time();
-            long double duration = time_in_ms(start, end);
+            search_limits limits( time_limit_ms, ( target_gap >= 0 ? search_limits::target_from_gap(bks[i], target_gap) : -1 ), 1 );
+            wall_timer timer;
+            int solution_cost = ( total_threads > 1 ? generate_solution_parallel( instance_name, iter, total_threads, GRASP_SEED, granular_neighbors, limits, split_initial_tour, construction_alpha, savings_initial ) : generate_solution( instance_name, iter, granular_neighbors, limits, split_initial_tour, construction_alpha, savings_initial ) );
+            long double duration = time_in_ms(timer);
             out_file << iter << "," << duration << "," << solution_cost << "," << bks[i] << "," << (1.0 * solution_cost / bks[i] ) << endl; 
         }
         out_file.close();
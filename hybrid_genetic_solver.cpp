@@ -0,0 +1,288 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include "data_loader.h"
+#include "neighborhood_generator.h"
+#include "time_lib.h"
+#include "giant_tour.h"
+#include "cost_evaluator.h"
+
+using namespace std;
+
+/*
+ * Hybrid genetic search in the style of HGS (Vidal et al., 2012).
+ * Individuals are giant tours (giant_tour.h). A child is built by OX crossover of two parents
+ * chosen by binary tournament, cut into routes by Split, educated by the best improvement local
+ * search of the other solvers (exchange and delete_and_insert through the move_cache on long routes, then 2-opt,
+ * Or-opt and 2-opt*), and written back as the giant tour of its improved routes.
+ * The population grows from mu to mu + lambda individuals, then the survivors are chosen by
+ * biased fitness: the rank by cost plus the rank by contribution to diversity (average broken
+ * pairs distance to the closest individuals), with clones removed first. This keeps the search
+ * from collapsing on one solution, which is where GRASP and SA stall.
+ */
+
+struct individual
+{
+    vector<int> tour; // giant tour of routes
+    vector< vector<int> > routes;
+    vector<int> route_capacities;
+    int cost;
+    vector<int> successor, predecessor; // neighbors of each customer in its route (depot at the ends)
+    vector< pair<double, individual*> > closest; // broken pairs distance to the others, sorted
+    double biased_fitness;
+};
+
+struct hybrid_genetic_solver
+{
+    shared_ptr<const instance> data_inst; // shared, never copied
+    neighborhood_generator n_generator; // random stream of the search
+    cost_evaluator evaluator;
+    move_cache cache;
+
+    // parameters
+    int mu = 25;            // population size after a survivor selection
+    int lambda = 40;        // children generated before the next selection
+    int elite = 4;          // best individuals protected by the biased fitness
+    int closest_count = 5;  // individuals averaged in the diversity contribution
+    int max_stall = 2500;   // iterations without improving the best solution
+
+    vector< unique_ptr<individual> > population;
+    vector<int> best_tour;
+    vector< vector<int> > best_routes;
+    int best_cost;
+    long long iterations_done = 0;
+
+    hybrid_genetic_solver( shared_ptr<const instance> ins ) {
+        data_inst = ins;
+        n_generator = neighborhood_generator(ins);
+        evaluator = cost_evaluator(ins.get());
+    }
+
+    /*
+     * Education: Split of the giant tour, then best improvement until no exchange, delete_and_insert,
+     * 2-opt, Or-opt or 2-opt* improves the routes
+     */
+    void educate( individual& ind ) {
+        split_giant_tour(ind.tour, *data_inst, ind.routes, ind.route_capacities);
+        bool improved = true;
+        while (improved) {
+            if (use_move_cache(ind.routes)) {
+                cache.rebuild(ind.routes, ind.route_capacities, *data_inst);
+                while (cache.apply_best(ind.routes, ind.route_capacities, *data_inst, DELETE_AND_INSERT) ||
+                       cache.apply_best(ind.routes, ind.route_capacities, *data_inst, EXCHANGE));
+            }
+            else while (apply_best_delete_and_insert(ind.routes, ind.route_capacities, *data_inst) ||
+                        apply_best_exchange(ind.routes, ind.route_capacities, *data_inst));
+            improved = false;
+            while (apply_best_two_opt(ind.routes, ind.route_capacities, *data_inst)) improved = true;
+            while (apply_best_or_opt(ind.routes, ind.route_capacities, *data_inst)) improved = true;
+            while (apply_best_two_opt_star(ind.routes, ind.route_capacities, *data_inst)) improved = true;
+        }
+        ind.tour = giant_tour_of(ind.routes);
+        ind.cost = evaluator.solution_cost(ind.routes);
+
+        ind.successor.assign(data_inst->dimension, data_inst->depot_index);
+        ind.predecessor.assign(data_inst->dimension, data_inst->depot_index);
+        for (const vector<int>& route : ind.routes) {
+            for (int i = 1; i < (int) route.size(); i++) {
+                ind.predecessor[route[i]] = route[i - 1];
+                if (i + 1 < (int) route.size()) ind.successor[route[i]] = route[i + 1];
+            }
+        }
+    }
+
+    // Fraction of the customers whose neighbors differ between the two solutions (Prins, 2009)
+    double broken_pairs_distance( const individual& a, const individual& b ) {
+        int depot = data_inst->depot_index, differences = 0;
+        for (int v = 0; v < data_inst->dimension; v++) {
+            if (v == depot) continue;
+            if (a.successor[v] != b.successor[v] && a.successor[v] != b.predecessor[v]) differences++;
+            if (a.predecessor[v] == depot && b.predecessor[v] != depot && b.successor[v] != depot) differences++;
+        }
+        return (double) differences / (data_inst->dimension - 1);
+    }
+
+    double average_closest_distance( const individual& ind ) {
+        int total = min(closest_count, (int) ind.closest.size());
+        if (total == 0) return 0;
+        double sum = 0;
+        for (int k = 0; k < total; k++) sum += ind.closest[k].first;
+        return sum / total;
+    }
+
+    void add_individual( unique_ptr<individual> ind ) {
+        for (const unique_ptr<individual>& other : population) {
+            double distance = broken_pairs_distance(*ind, *other);
+            other->closest.insert(upper_bound(other->closest.begin(), other->closest.end(), make_pair(distance, ind.get())), make_pair(distance, ind.get()));
+            ind->closest.emplace_back(distance, other.get());
+        }
+        sort(ind->closest.begin(), ind->closest.end());
+        if (ind->cost < best_cost) {
+            best_cost = ind->cost;
+            best_tour = ind->tour;
+            best_routes = ind->routes;
+        }
+        population.push_back(move(ind));
+    }
+
+    void remove_individual( int index ) {
+        individual* gone = population[index].get();
+        for (const unique_ptr<individual>& other : population) {
+            auto& closest = other->closest;
+            closest.erase(remove_if(closest.begin(), closest.end(), [&] (const pair<double, individual*>& entry) { return entry.second == gone; }), closest.end());
+        }
+        population.erase(population.begin() + index);
+    }
+
+    // biased fitness = rank by cost + (1 - elite / size) * rank by diversity, ranks scaled to [0, 1]
+    void update_biased_fitness() {
+        int size = (int) population.size();
+        if (size == 1) {
+            population[0]->biased_fitness = 0;
+            return;
+        }
+        vector< pair<double, int> > by_diversity;
+        for (int i = 0; i < size; i++) by_diversity.emplace_back(-average_closest_distance(*population[i]), i);
+        sort(by_diversity.begin(), by_diversity.end());
+        vector<int> diversity_rank(size);
+        for (int r = 0; r < size; r++) diversity_rank[by_diversity[r].second] = r;
+
+        vector<int> by_cost(size);
+        iota(by_cost.begin(), by_cost.end(), 0);
+        stable_sort(by_cost.begin(), by_cost.end(), [&] (int a, int b) { return population[a]->cost < population[b]->cost; });
+        for (int r = 0; r < size; r++) {
+            int i = by_cost[r];
+            population[i]->biased_fitness = (double) r / (size - 1) + (1.0 - (double) elite / size) * diversity_rank[i] / (size - 1);
+        }
+    }
+
+    // Removes individuals until mu are left: clones first, then the worst biased fitness
+    void select_survivors() {
+        while ((int) population.size() > mu) {
+            update_biased_fitness();
+            int worst = -1;
+            bool worst_is_clone = false;
+            for (int i = 0; i < (int) population.size(); i++) {
+                const individual& ind = *population[i];
+                bool clone = (!ind.closest.empty() && ind.closest[0].first < 1e-9);
+                if (worst < 0 || (clone && !worst_is_clone) || (clone == worst_is_clone && ind.biased_fitness > population[worst]->biased_fitness)) {
+                    worst = i;
+                    worst_is_clone = clone;
+                }
+            }
+            remove_individual(worst);
+        }
+    }
+
+    const individual& binary_tournament() {
+        update_biased_fitness();
+        const individual& a = *population[n_generator.rng() % population.size()];
+        const individual& b = *population[n_generator.rng() % population.size()];
+        return (a.biased_fitness < b.biased_fitness ? a : b);
+    }
+
+    // Ordered crossover: a circular segment of the first parent, the other customers in the order of the second
+    vector<int> ordered_crossover( const vector<int>& first, const vector<int>& second ) {
+        int n = (int) first.size();
+        int start = n_generator.rng() % n, end = n_generator.rng() % n;
+        vector<int> child(n);
+        vector<char> taken(data_inst->dimension, 0);
+        int length = (end - start + n) % n + 1;
+        for (int k = 0; k < length; k++) {
+            int pos = (start + k) % n;
+            child[pos] = first[pos];
+            taken[first[pos]] = 1;
+        }
+        int pos = (end + 1) % n;
+        for (int k = 0; k < n; k++) {
+            int customer = second[(end + 1 + k) % n];
+            if (taken[customer]) continue;
+            child[pos] = customer;
+            pos = (pos + 1) % n;
+        }
+        return child;
+    }
+
+    /*
+     * Runs the genetic search for at most max_iterations children (and until limits is reached
+     * or max_stall children in a row did not improve the best solution). Returns the best cost.
+     */
+    int solve( long long max_iterations, search_limits limits = search_limits() ) {
+        population.clear();
+        best_cost = 0x3f3f3f3f;
+        vector<int> customers;
+        for (int v = 0; v < data_inst->dimension; v++)
+            if (v != data_inst->depot_index) customers.push_back(v);
+
+        for (int k = 0; k < 4 * mu && !limits.should_stop(best_cost); k++) {
+            unique_ptr<individual> ind(new individual());
+            ind->tour = customers;
+            shuffle(ind->tour.begin(), ind->tour.end(), n_generator.rng);
+            educate(*ind);
+            add_individual(move(ind));
+            if ((int) population.size() >= mu + lambda) select_survivors();
+        }
+
+        int stall = 0;
+        for (iterations_done = 0; iterations_done < max_iterations && stall < max_stall && !limits.should_stop(best_cost); iterations_done++) {
+            const individual& first = binary_tournament();
+            const individual& second = binary_tournament();
+            unique_ptr<individual> child(new individual());
+            child->tour = ordered_crossover(first.tour, second.tour);
+            educate(*child);
+            int previous_best = best_cost;
+            add_individual(move(child));
+            stall = (best_cost < previous_best ? 0 : stall + 1);
+            if ((int) population.size() >= mu + lambda) select_survivors();
+        }
+        return best_cost;
+    }
+};
+
+/*
+ * Usage: ./HGS_SOLVER [--time-limit ms] [--target-gap g] [--seed s]
+ * For each instance, one run per budget of children (same CSV columns as the GRASP, in hgs_results/)
+ */
+int main(int argc, char** argv)
+{
+    long double time_limit_ms = 0;
+    double target_gap = -1;
+    unsigned seed = 13;
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        if (arg == "--time-limit" && a + 1 < argc) time_limit_ms = atof(argv[++a]);
+        else if (arg == "--target-gap" && a + 1 < argc) target_gap = atof(argv[++a]);
+        else if (arg == "--seed" && a + 1 < argc) seed = (unsigned) atoll(argv[++a]);
+        else {
+            cerr << "Invalid option: " << arg << endl;
+            cerr << "Usage: ./HGS_SOLVER [--time-limit ms] [--target-gap g] [--seed s]" << endl;
+            return 1;
+        }
+    }
+    vector<string> instances = { "X-n101-k25", "X-n110-k13", "X-n115-k10", "X-n204-k19" };
+    vector<int> bks = { 27591, 14971, 12747, 19565 };
+    vector<int> iterations = { 100, 500, 1000, 2500 };
+
+    for (int i = 0; i < (int) instances.size(); i++) {
+        shared_ptr<const instance> inst = load_shared_instance("instances/" + instances[i] + ".vrp");
+        ofstream out_file("hgs_results/" + instances[i] + ".csv");
+        cout << "Rodando para a imagem " << instances[i] << endl;
+        out_file << "Total iteracoes,Tempo total(ms),Solucao encontrada,BKS,Approximation Ratio" << endl;
+        for (int iter : iterations) {
+            hybrid_genetic_solver solver(inst);
+            solver.n_generator.set_seed(seed);
+            search_limits limits(time_limit_ms, (target_gap >= 0 ? search_limits::target_from_gap(bks[i], target_gap) : -1), 1);
+            wall_timer timer;
+            int solution_cost = solver.solve(iter, limits);
+            long double duration = timer.elapsed_ms();
+            cout << iter << " iteracoes: " << solution_cost << " em " << duration << " ms" << endl;
+            out_file << iter << "," << duration << "," << solution_cost << "," << bks[i] << "," << (1.0 * solution_cost / bks[i]) << endl;
+        }
+        out_file.close();
+    }
+    return 0;
+}
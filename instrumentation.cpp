@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+#include "instrumentation.h"
+
+static const char* operator_names[INSTRUMENTED_OPERATORS] = { "exchange", "delete_and_insert", "two_opt", "two_opt_reversal", "or_opt", "two_opt_star" };
+static const char* phase_names[PHASE_COUNT] = { "construction", "local_search", "cost_evaluation" };
+
+void search_counters::add( const search_counters& other )
+{
+    for(int t = 0; t < INSTRUMENTED_OPERATORS; ++t)
+    {
+        operators[t].proposed += other.operators[t].proposed;
+        operators[t].scans += other.operators[t].scans;
+        operators[t].accepted += other.operators[t].accepted;
+        operators[t].improving += other.operators[t].improving;
+    }
+    for(int p = 0; p < PHASE_COUNT; ++p) phase_ms[p] += other.phase_ms[p];
+}
+
+// Phase being timed on this thread (-1 = none) and when it was last charged
+struct phase_clock
+{
+    int current = -1;
+    chrono::steady_clock::time_point since;
+
+    void charge( chrono::steady_clock::time_point now )
+    {
+        if( current >= 0 ) thread_counters().phase_ms[current] += chrono::duration<double, milli>(now - since).count();
+        since = now;
+    }
+};
+
+static thread_local search_counters counters;
+static thread_local phase_clock clock_of_thread;
+
+search_counters& thread_counters() { return counters; }
+
+phase_timer::phase_timer( search_phase phase )
+{
+    clock_of_thread.charge( chrono::steady_clock::now() );
+    previous = clock_of_thread.current;
+    clock_of_thread.current = phase;
+}
+
+phase_timer::~phase_timer()
+{
+    clock_of_thread.charge( chrono::steady_clock::now() );
+    clock_of_thread.current = previous;
+}
+
+void search_trajectory::clear()
+{
+    points.clear();
+    start = chrono::steady_clock::now();
+}
+
+// Creates the directory of path, if it has one (only the last level)
+static void make_parent_directory( const string& path )
+{
+    size_t slash = path.find_last_of('/');
+    if( slash != string::npos ) mkdir( path.substr(0, slash).c_str(), 0755 );
+}
+
+bool search_trajectory::write_csv( const string& path ) const
+{
+    make_parent_directory( path );
+    FILE* out = fopen( path.c_str(), "w" );
+    if( out == nullptr )
+    {
+        cerr << "Nao foi possivel escrever " << path << endl;
+        return false;
+    }
+    fprintf(out, "iteration,ms,temperature,cost,best_cost\n");
+    for(const trajectory_point& p : points) fprintf(out, "%lld,%.3f,%g,%d,%d\n", p.iteration, p.ms, p.temperature, p.cost, p.best_cost);
+    fclose(out);
+    return true;
+}
+
+search_counters take_thread_counters()
+{
+    search_counters taken = counters;
+    counters = search_counters();
+    return taken;
+}
+
+bool write_run_counters( const string& path, const search_counters& totals, double wall_ms )
+{
+    make_parent_directory( path );
+    FILE* out = fopen( path.c_str(), "w" );
+    if( out == nullptr )
+    {
+        cerr << "Nao foi possivel escrever " << path << endl;
+        return false;
+    }
+    long long improvements = 0;
+    fprintf(out, "metric,operator,value\n");
+    for(int t = 0; t < INSTRUMENTED_OPERATORS; ++t)
+    {
+        const operator_counters& op = totals.operators[t];
+        if( op.proposed + op.scans == 0 ) continue;
+        fprintf(out, "proposed,%s,%lld\n", operator_names[t], op.proposed);
+        fprintf(out, "scans,%s,%lld\n", operator_names[t], op.scans);
+        fprintf(out, "accepted,%s,%lld\n", operator_names[t], op.accepted);
+        fprintf(out, "rejected,%s,%lld\n", operator_names[t], op.proposed + op.scans - op.accepted);
+        fprintf(out, "improving,%s,%lld\n", operator_names[t], op.improving);
+        improvements += op.improving;
+    }
+    for(int p = 0; p < PHASE_COUNT; ++p) fprintf(out, "phase_ms,%s,%.3f\n", phase_names[p], totals.phase_ms[p]);
+    fprintf(out, "wall_ms,,%.3f\n", wall_ms);
+    fprintf(out, "improvements_per_second,,%.1f\n", ( wall_ms > 0 ? 1000.0 * improvements / wall_ms : 0 ));
+    fclose(out);
+    return true;
+}
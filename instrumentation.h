@@ -0,0 +1,112 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+/*
+ * Search instrumentation, compiled in only with -DCVRP_INSTRUMENT:
+ *     make -f makefile_grasp FLAGS='-g -c -pthread -DCVRP_INSTRUMENT'
+ * INSTRUMENT(x) expands to x with the flag and to nothing without it, so the hot loops of a normal
+ * build are unchanged. With it:
+ * - every thread counts, per move_type, the single moves proposed, the best improvement scans,
+ *   the moves applied and how many of them improved (thread_counters, no locks in the loops);
+ * - phase_timer charges wall time to construction, local search and cost evaluation; a nested
+ *   phase pauses the outer one, so the three times do not overlap;
+ * - search_trajectory samples (iteration, temperature, cost, best cost) of an SA run.
+ * At the end of a run every thread of it hands its counters over with take_thread_counters, and
+ * the solver writes their sum as one CSV per run with write_run_counters (and the trajectory with
+ * write_csv), in traces/.
+ */
+#ifdef CVRP_INSTRUMENT
+#define INSTRUMENT(x) x
+#else
+#define INSTRUMENT(x)
+#endif
+
+constexpr int INSTRUMENTED_OPERATORS = 6; // one per move_type
+constexpr int TRAJECTORY_EVERY = 100;     // iterations between two points of a trajectory
+
+enum search_phase { PHASE_CONSTRUCTION, PHASE_LOCAL_SEARCH, PHASE_COST_EVALUATION, PHASE_COUNT };
+
+struct operator_counters
+{
+    long long proposed = 0;  // single moves evaluated (propose_move)
+    long long scans = 0;     // best improvement scans of the whole neighborhood
+    long long accepted = 0;  // moves applied
+    long long improving = 0; // applied moves that lowered the cost
+};
+
+struct search_counters
+{
+    operator_counters operators[INSTRUMENTED_OPERATORS];
+    double phase_ms[PHASE_COUNT] = {};
+
+    void add( const search_counters& other );
+};
+
+// Counters of the calling thread
+search_counters& thread_counters();
+
+inline void record_proposal( int type ) { thread_counters().operators[type].proposed++; }
+
+inline void record_applied( int type, int delta )
+{
+    operator_counters& op = thread_counters().operators[type];
+    op.accepted++;
+    op.improving += ( delta < 0 );
+}
+
+inline void record_scan( int type, bool improved )
+{
+    operator_counters& op = thread_counters().operators[type];
+    op.scans++;
+    op.accepted += improved;
+    op.improving += improved;
+}
+
+struct phase_timer
+{
+    int previous;
+
+    explicit phase_timer( search_phase phase );
+    ~phase_timer();
+};
+
+struct trajectory_point
+{
+    long long iteration;
+    float temperature;
+    int cost, best_cost;
+    double ms;
+};
+
+struct search_trajectory
+{
+    vector<trajectory_point> points;
+    chrono::steady_clock::time_point start;
+
+    void clear();
+    inline void record( long long iteration, float temperature, int cost, int best_cost )
+    {
+        if( iteration % TRAJECTORY_EVERY != 0 ) return;
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        points.push_back( trajectory_point{ iteration, temperature, cost, best_cost, ms } );
+    }
+    bool write_csv( const string& path ) const;
+};
+
+// Returns the counters of the calling thread and clears them (also used to start a run from zero)
+search_counters take_thread_counters();
+
+/*
+ * Writes the counters of a run to path as metric,operator,value rows, with the wall time and the
+ * improvements per second. The directory of path is created if needed. Returns false if the file
+ * cannot be written.
+ */
+bool write_run_counters( const string& path, const search_counters& totals, double wall_ms );
+
+#endif
@@ -4,21 +4,15 @@
 #include <cstdio>
 #include "data_loader.h"
 #include "neighborhood_generator.h"
+#include "gain_kernel.h"
+#include "instrumentation.h"
+#include "solution_hash.h"
+#include "route_bounds.h"
 #include <random>
+#include <tuple>
 
 using namespace std;
 
-int route_cost(vector<int> route, instance data_inst) {
-    int cost = 0;
-    for (int i = 0; i < (int)route.size() - 1; i++) {
-        int dist = data_inst.adjacency_matrix[route[i]][route[i+1]];
-        cost += dist;
-    }
-    int dist_origin = data_inst.adjacency_matrix[route[route.size() - 1]][data_inst.depot_index];
-    cost += dist_origin;
-    return cost;
-}
-
 // EXCHANGE
 void swap_cities(vector<vector<int>> &updated_routes, int route1, int route2, int idx1, int idx2) {
     int temp = updated_routes[route1][idx1];
@@ -26,93 +20,227 @@ void swap_cities(vector<vector<int>> &updated_routes, int route1, int route2, in
     updated_routes[route2][idx2] = temp;
 }
 
-void exchange(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, instance data_inst) {
-    int did_exchange = 0;
-    while (!did_exchange) {
+// Node visited right after position idx (the route is closed at the depot)
+inline int next_node(const vector<int>& route, int idx, const instance& data_inst) {
+    return (idx == (int)route.size() - 1 ? data_inst.depot_index : route[idx + 1]);
+}
+
+// Every delta below is a sum over the edges a move adds minus the ones it removes. It is written
+// once for an edge weight: the distance gives the cost delta, the Zobrist key the hash delta.
+struct edge_distance {
+    typedef int value;
+    const distance_matrix& d;
+    inline int operator()(int u, int v) const { return d.dist(u, v); }
+};
+
+struct edge_zobrist {
+    typedef uint64_t value; // unsigned, so the differences wrap around like the hash
+    inline uint64_t operator()(int u, int v) const { return edge_key(u, v); }
+};
+
+// Exact variation of swapping routes[route1][idx1] and routes[route2][idx2]
+template<class weight>
+typename weight::value exchange_change(const vector<vector<int>> &routes, int route1, int route2, int idx1, int idx2, const instance& data_inst, const weight& w) {
+    if (route1 == route2 && idx1 == idx2) return 0;
+    if (route1 == route2 && idx1 > idx2) swap(idx1, idx2);
+    const vector<int>& fst = routes[route1];
+    const vector<int>& snd = routes[route2];
+    int F = fst[idx1], S = snd[idx2];
+    int prev_fst = fst[idx1 - 1], next_fst = next_node(fst, idx1, data_inst);
+    int prev_snd = snd[idx2 - 1], next_snd = next_node(snd, idx2, data_inst);
+    if (route1 == route2 && idx2 == idx1 + 1) {
+        // adjacent cities: prev_fst -> F -> S -> next_snd becomes prev_fst -> S -> F -> next_snd
+        return w(prev_fst, S) + w(S, F) + w(F, next_snd) - w(prev_fst, F) - w(F, S) - w(S, next_snd);
+    }
+    typename weight::value delta = w(prev_fst, S) + w(S, next_fst) + w(prev_snd, F) + w(F, next_snd);
+    delta -= w(prev_fst, F) + w(F, next_fst) + w(prev_snd, S) + w(S, next_snd);
+    return delta;
+}
+
+int exchange_delta(const vector<vector<int>> &routes, int route1, int route2, int idx1, int idx2, const instance& data_inst) {
+    return exchange_change(routes, route1, route2, idx1, idx2, data_inst, edge_distance{data_inst.distances});
+}
+
+move_proposal propose_exchange(const vector<vector<int>> &routes, const vector<int> &routes_capacities, const instance& data_inst, mt19937& rng) {
+    while (true) {
         // randomly select index two indexes to swap - do not allow index 0
-        int route1 = rand() % updated_routes.size();
-        int route2 = rand() % updated_routes.size();
-        int idx1 = (rand() % (updated_routes[route1].size() - 1)) + 1;
-        int idx2 = (rand() % (updated_routes[route2].size() - 1)) + 1;
+        int route1 = rng() % routes.size();
+        int route2 = rng() % routes.size();
+        int idx1 = (rng() % (routes[route1].size() - 1)) + 1;
+        int idx2 = (rng() % (routes[route2].size() - 1)) + 1;
         
         // find the cities in those indexes
-        int city_idx1 = updated_routes[route1][idx1];
-        int city_idx2 = updated_routes[route2][idx2];
+        int city_idx1 = routes[route1][idx1];
+        int city_idx2 = routes[route2][idx2];
         
-        if (route1 != route2 || idx1 != idx2) { // randomly selected nodes are different
-            // exchange within the same route - no need to check for capacity constraints
-            if (route1 == route2) {
-                swap_cities(updated_routes, route1, route2, idx1, idx2);
-                did_exchange = 1;
-            }
-            // exchange within different routes - need to check if capacity is exceeded
-            else {
-                int capacity_route1 = updated_routes_capacities[route1];
-                int capacity_route2 = updated_routes_capacities[route2];
-                
-                int updated_capacity_route1 = capacity_route1 - data_inst.demands[city_idx1] + data_inst.demands[city_idx2];
-                int updated_capacity_route2 = capacity_route2 - data_inst.demands[city_idx2] + data_inst.demands[city_idx1];
-                
-                if (updated_capacity_route1 < data_inst.uniform_vehicle_capacity &&
-                    updated_capacity_route2 < data_inst.uniform_vehicle_capacity) {
-                    updated_routes_capacities[route1] = updated_capacity_route1;
-                    updated_routes_capacities[route2] = updated_capacity_route2;
-                    swap_cities(updated_routes, route1, route2, idx1, idx2);
-                    did_exchange = 1;
-                }
-            }
+        if (route1 == route2 && idx1 == idx2) continue; // randomly selected nodes must be different
+        // exchange within different routes - need to check if capacity is exceeded
+        if (route1 != route2) {
+            int updated_capacity_route1 = routes_capacities[route1] - data_inst.demands[city_idx1] + data_inst.demands[city_idx2];
+            int updated_capacity_route2 = routes_capacities[route2] - data_inst.demands[city_idx2] + data_inst.demands[city_idx1];
+            if (updated_capacity_route1 >= data_inst.uniform_vehicle_capacity ||
+                updated_capacity_route2 >= data_inst.uniform_vehicle_capacity) continue;
         }
+        return move_proposal{EXCHANGE, route1, idx1, route2, idx2, exchange_delta(routes, route1, route2, idx1, idx2, data_inst), 0};
     }
 }
 
-bool apply_best_exchange(vector< vector<int> >& updated_routes, vector< int >& updated_route_capacities, instance data_inst)
+void apply_exchange(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const move_proposal& m, const instance& data_inst) {
+    if (m.idx1 < 0) return; // empty proposal, nothing to do
+    // exchange within the same route - no need to update capacities
+    if (m.route1 != m.route2) {
+        int city_idx1 = updated_routes[m.route1][m.idx1];
+        int city_idx2 = updated_routes[m.route2][m.idx2];
+        updated_routes_capacities[m.route1] += data_inst.demands[city_idx2] - data_inst.demands[city_idx1];
+        updated_routes_capacities[m.route2] += data_inst.demands[city_idx1] - data_inst.demands[city_idx2];
+    }
+    swap_cities(updated_routes, m.route1, m.route2, m.idx1, m.idx2);
+}
+
+void exchange(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const instance& data_inst, mt19937& rng) {
+    apply_exchange(updated_routes, updated_routes_capacities, propose_exchange(updated_routes, updated_routes_capacities, data_inst, rng), data_inst);
+}
+
+// The vectorized kernels read whole rows of the distance matrix, so they need the DENSE layout
+inline bool use_gain_kernel(const instance& data_inst) {
+    return active_gain_kernel() != KERNEL_OFF && data_inst.distances.mode == distance_matrix::DENSE;
+}
+
+// Best exchange between first_route and second_route (first_route <= second_route), in the scan
+// order of apply_best_exchange. delta = 1 when the pair has no feasible exchange.
+// With block (every route laid out, as kept by move_cache) the gain kernel scores second_route.
+move_proposal best_exchange_between(const vector< vector<int> >& updated_routes, const vector< int >& updated_route_capacities, const instance& data_inst, int first_route, int second_route, const route_block* block = nullptr)
 {
-    int total_routes = (int) updated_routes.size();
     int best_benefit = -1;
-    int best_first_route = -1;
     int best_first_index = -1;
-    int best_second_route = -1;
     int best_second_index = -1;
+    int fst_sz = (int) updated_routes[first_route].size();
+    int snd_sz = (int) updated_routes[second_route].size();
+    if( first_route != second_route && block != nullptr ) {
+        // all positions of the second route are scored at once (see gain_kernel.h)
+        int from = block->begin[second_route] + 1, to = block->begin[second_route + 1];
+        const distance_matrix& d = data_inst.distances;
+        int capacity = data_inst.uniform_vehicle_capacity;
+        for(int first_index = 1; first_index < fst_sz; ++first_index) {
+            int F = updated_routes[first_route][first_index];
+            int prev_fst = updated_routes[first_route][first_index - 1];
+            int next_fst = ( first_index == fst_sz - 1 ? data_inst.depot_index : updated_routes[first_route][first_index + 1] );
+            int position;
+            int gain = best_exchange_gain(*block, from, to, d.row(prev_fst), d.row(next_fst), d.row(F),
+                                          capacity - updated_route_capacities[first_route] + data_inst.demands[F], capacity - data_inst.demands[F], position);
+            if( position < 0 ) continue;
+            int second_index = position - block->begin[second_route];
+            gain += d.dist(prev_fst, F) + d.dist(F, next_fst);
+            if( gain > best_benefit ) {
+                best_first_index = first_index;
+                best_second_index = second_index;
+                best_benefit = gain;
+            }
+        }
+        return move_proposal{EXCHANGE, first_route, best_first_index, second_route, best_second_index, -best_benefit, 0};
+    }
+    for(int first_index = 1; first_index < fst_sz; ++first_index) {
+        for(int second_index = 1; second_index < snd_sz; ++second_index) {
+            int F = updated_routes[first_route][first_index];
+            int S = updated_routes[second_route][second_index];
+            int gain;
+            // inside a route adjacent cities share edges, so the exact delta is used
+            if ( first_route == second_route ) gain = -exchange_delta(updated_routes, first_route, second_route, first_index, second_index, data_inst);
+            else {
+                int cap_fst = updated_route_capacities[first_route], cap_snd = updated_route_capacities[second_route];
+                int upd_cap_fst = cap_fst - data_inst.demands[F] + data_inst.demands[S];
+                int upd_cap_snd = cap_snd - data_inst.demands[S] + data_inst.demands[F];
+                if ( max(upd_cap_fst, upd_cap_snd) > data_inst.uniform_vehicle_capacity) continue;
+                int prev_fst = updated_routes[first_route][first_index - 1];
+                int next_fst = ( first_index == fst_sz - 1 ? data_inst.depot_index : updated_routes[first_route][first_index + 1] );
+                int prev_snd = updated_routes[second_route][second_index - 1];
+                int next_snd = ( second_index == snd_sz - 1? data_inst.depot_index : updated_routes[second_route][second_index + 1]);
+                gain = data_inst.distances.dist(prev_fst, F) + data_inst.distances.dist(F, next_fst);
+                gain += data_inst.distances.dist(prev_snd, S) + data_inst.distances.dist(S, next_snd);
+                gain -= ( data_inst.distances.dist(prev_fst, S) + data_inst.distances.dist(S, next_fst));
+                gain -= ( data_inst.distances.dist(prev_snd, F) + data_inst.distances.dist(F, next_snd));
+            }
+
+            if( gain > best_benefit ) {
+                best_first_index = first_index;
+                best_second_index = second_index; 
+                best_benefit = gain;
+            }
+        }
+    }
+    return move_proposal{EXCHANGE, first_route, best_first_index, second_route, best_second_index, -best_benefit, 0};
+}
 
+// Keeps the best move of a scan: larger gain first, then the earliest in the scan order
+// (route1, route2, idx1, idx2), which is the move the plain nested loops would keep
+inline void keep_best(move_proposal& best_move, const move_proposal& candidate) {
+    if( candidate.delta != best_move.delta ) {
+        if( candidate.delta < best_move.delta ) best_move = candidate;
+        return;
+    }
+    if( make_tuple(candidate.route1, candidate.route2, candidate.idx1, candidate.idx2) < make_tuple(best_move.route1, best_move.route2, best_move.idx1, best_move.idx2) ) best_move = candidate;
+}
+
+// apply_best_exchange with the gain kernel: each customer is scored against every position of
+// the following routes in a single call over the whole solution laid out as one block.
+// Route pairs are not pruned here (route_bounds.h): splitting the call costs more than it saves.
+move_proposal best_exchange_blocked(const vector< vector<int> >& updated_routes, const vector< int >& updated_route_capacities, const instance& data_inst)
+{
+    thread_local route_block block;
+    block.load_routes(updated_routes, updated_route_capacities, data_inst);
+    const distance_matrix& d = data_inst.distances;
+    int total_routes = (int) updated_routes.size();
+    int capacity = data_inst.uniform_vehicle_capacity;
+    move_proposal best_move{EXCHANGE, -1, -1, -1, -1, 1, 0};
     for(int first_route = 0; first_route < total_routes; ++first_route) {
+        keep_best(best_move, best_exchange_between(updated_routes, updated_route_capacities, data_inst, first_route, first_route));
         int fst_sz = (int) updated_routes[first_route].size();
+        int from = block.begin[first_route + 1] + 1, to = block.begin[total_routes];
+        if( from >= to ) continue;
+        for(int first_index = 1; first_index < fst_sz; ++first_index) {
+            int F = updated_routes[first_route][first_index];
+            int prev_fst = updated_routes[first_route][first_index - 1];
+            int next_fst = ( first_index == fst_sz - 1 ? data_inst.depot_index : updated_routes[first_route][first_index + 1] );
+            int position;
+            int gain = best_exchange_gain(block, from, to, d.row(prev_fst), d.row(next_fst), d.row(F),
+                                          capacity - updated_route_capacities[first_route] + data_inst.demands[F], capacity - data_inst.demands[F], position);
+            if( position < 0 ) continue;
+            gain += d.dist(prev_fst, F) + d.dist(F, next_fst);
+            int second_route = block.route[position];
+            keep_best(best_move, move_proposal{EXCHANGE, first_route, first_index, second_route, position - block.begin[second_route], -gain, 0});
+        }
+    }
+    return best_move;
+}
+
+bool apply_best_exchange(vector< vector<int> >& updated_routes, vector< int >& updated_route_capacities, const instance& data_inst)
+{
+    if( use_gain_kernel(data_inst) ) {
+        move_proposal best_move = best_exchange_blocked(updated_routes, updated_route_capacities, data_inst);
+        if( best_move.delta >= 0 ) return false;
+        apply_exchange( updated_routes, updated_route_capacities, best_move, data_inst );
+        return true;
+    }
+    int total_routes = (int) updated_routes.size();
+    thread_local vector<route_summary> summaries;
+    bool pruning = route_pruning_enabled();
+    if( pruning ) summarize_routes(updated_routes, data_inst, summaries);
+    move_proposal best_move{EXCHANGE, -1, -1, -1, -1, 1, 0};
+    for(int first_route = 0; first_route < total_routes; ++first_route) {
         for(int second_route = first_route; second_route < total_routes; ++second_route) {
-            int snd_sz = (int) updated_routes[second_route].size();
-            for(int first_index = 1; first_index < fst_sz; ++first_index) {
-                for(int second_index = 1; second_index < snd_sz; ++second_index) {
-                    int F = updated_routes[first_route][first_index];
-                    int S = updated_routes[second_route][second_index];
-                    int cap_fst = updated_route_capacities[first_route], cap_snd = updated_route_capacities[second_route];
-                    int upd_cap_fst = cap_fst - data_inst.demands[F] + data_inst.demands[S];
-                    int upd_cap_snd = cap_snd - data_inst.demands[S] + data_inst.demands[F];
-                    if ( max(upd_cap_fst, upd_cap_snd) <= data_inst.uniform_vehicle_capacity) {
-                        int prev_fst = updated_routes[first_route][first_index - 1];
-                        int next_fst = ( first_index == fst_sz - 1 ? data_inst.depot_index : updated_routes[first_route][first_index + 1] );
-                        int prev_snd = updated_routes[second_route][second_index - 1];
-                        int next_snd = ( second_index == snd_sz - 1? data_inst.depot_index : updated_routes[second_route][second_index + 1]);
-                        int gain = data_inst.adjacency_matrix[prev_fst][F] + data_inst.adjacency_matrix[F][next_fst];
-                        gain += data_inst.adjacency_matrix[prev_snd][S] + data_inst.adjacency_matrix[S][next_snd];
-                        gain -= ( data_inst.adjacency_matrix[prev_fst][S] + data_inst.adjacency_matrix[S][next_fst]);
-                        gain -= ( data_inst.adjacency_matrix[prev_snd][F] + data_inst.adjacency_matrix[F][next_snd]);
-
-                        if( gain > best_benefit ) {
-                            best_first_route = first_route; best_first_index = first_index;
-                            best_second_route = second_route; best_second_index = second_index; 
-                            best_benefit = gain;
-                        }
-                    }
-                }
-            }
+            if( pruning && second_route != first_route && !exchange_may_improve(summaries[first_route], summaries[second_route]) ) continue;
+            move_proposal candidate = best_exchange_between(updated_routes, updated_route_capacities, data_inst, first_route, second_route);
+            if( candidate.delta < best_move.delta ) best_move = candidate;
         }
     }
-    if( best_benefit <= 0) return false;
+    if( best_move.delta >= 0 ) return false;
     
-    swap_cities( updated_routes, best_first_route, best_second_route, best_first_index, best_second_index );
+    apply_exchange( updated_routes, updated_route_capacities, best_move, data_inst );
     return true;
 }
 
 // DELETE AND INSERT
-void move(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, instance data_inst, int route_del, int route_ins, int idx_del, int idx_ins) {
+void move(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const instance& data_inst, int route_del, int route_ins, int idx_del, int idx_ins) {
     int moved_city = updated_routes[route_del][idx_del];
 
     updated_routes[route_del].erase(updated_routes[route_del].begin() + idx_del);
@@ -132,88 +260,392 @@ void move(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capac
     }
 }
 
-void delete_and_insert(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, instance data_inst) {
-    int did_exchange = 0;
+// Exact variation of move(): the city at routes[route_del][idx_del] is erased and
+// then inserted at position idx_ins of route_ins (indices after the erase)
+template<class weight>
+typename weight::value delete_and_insert_change(const vector<vector<int>> &routes, int route_del, int route_ins, int idx_del, int idx_ins, const instance& data_inst, const weight& w) {
+    if (route_del == route_ins && idx_del == idx_ins) return 0;
+    const vector<int>& del = routes[route_del];
+    const vector<int>& ins = routes[route_ins];
+    int city = del[idx_del];
+    int prev_del = del[idx_del - 1], next_del = next_node(del, idx_del, data_inst);
     
-    while (!did_exchange) {
+    typename weight::value delta;
+    if (route_del != route_ins && del.size() == 2) delta = -(w(prev_del, city) + w(city, next_del)); // route is erased by move()
+    else delta = w(prev_del, next_del) - w(prev_del, city) - w(city, next_del);
+    
+    int prev_ins, next_ins;
+    if (route_del != route_ins) {
+        prev_ins = ins[idx_ins - 1];
+        next_ins = (idx_ins == (int)ins.size() ? data_inst.depot_index : ins[idx_ins]);
+    }
+    else {
+        // positions refer to the route without the deleted city
+        auto reduced = [&] (int k) { return (k < idx_del ? del[k] : del[k + 1]); };
+        prev_ins = reduced(idx_ins - 1);
+        next_ins = (idx_ins == (int)del.size() - 1 ? data_inst.depot_index : reduced(idx_ins));
+    }
+    delta += w(prev_ins, city) + w(city, next_ins) - w(prev_ins, next_ins);
+    return delta;
+}
+
+int delete_and_insert_delta(const vector<vector<int>> &routes, int route_del, int route_ins, int idx_del, int idx_ins, const instance& data_inst) {
+    return delete_and_insert_change(routes, route_del, route_ins, idx_del, idx_ins, data_inst, edge_distance{data_inst.distances});
+}
+
+move_proposal propose_delete_and_insert(const vector<vector<int>> &routes, const vector<int> &routes_capacities, const instance& data_inst, mt19937& rng) {
+    while (true) {
         // randomly select index to delete and idx to insert - do not allow index 0
-        int route_del = rand() % updated_routes.size();
-        int route_ins = rand() % updated_routes.size();
-        int idx_del = (rand() % (updated_routes[route_del].size() - 1)) + 1;
-        int idx_ins = (rand() % (updated_routes[route_ins].size() - 1)) + 1;
+        int route_del = rng() % routes.size();
+        int route_ins = rng() % routes.size();
+        int idx_del = (rng() % (routes[route_del].size() - 1)) + 1;
+        int idx_ins = (rng() % (routes[route_ins].size() - 1)) + 1;
         // find the cities in those indexes
-        int city_del = updated_routes[route_del][idx_del];
+        int city_del = routes[route_del][idx_del];
        
-        if (route_del != route_ins || idx_del != idx_ins) {
-            // delete and add within the same route - no need to check for capacity constraints
-            if (route_del == route_ins) {
-                move(updated_routes, updated_routes_capacities, data_inst, route_del, route_ins, idx_del, idx_ins);
-                did_exchange = 1;
-            }
-            // add to different routes - need to check if capacity is exceeded
-            else {
-                int capacity_route_ins = updated_routes_capacities[route_ins] + data_inst.demands[city_del];
-                
-                if (capacity_route_ins < data_inst.uniform_vehicle_capacity) {
-                    move(updated_routes, updated_routes_capacities, data_inst, route_del, route_ins, idx_del, idx_ins);
-                    did_exchange = 1;
-                }
-            }
-        }
+        if (route_del == route_ins && idx_del == idx_ins) continue;
+        // add to different routes - need to check if capacity is exceeded
+        if (route_del != route_ins && routes_capacities[route_ins] + data_inst.demands[city_del] >= data_inst.uniform_vehicle_capacity) continue;
+        return move_proposal{DELETE_AND_INSERT, route_del, idx_del, route_ins, idx_ins, delete_and_insert_delta(routes, route_del, route_ins, idx_del, idx_ins, data_inst), 0};
     }
 }
 
-bool apply_best_delete_and_insert( vector< vector<int> >& updated_routes, vector<int>& updated_routes_capacities, instance data_inst)
+void delete_and_insert(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const instance& data_inst, mt19937& rng) {
+    move_proposal m = propose_delete_and_insert(updated_routes, updated_routes_capacities, data_inst, rng);
+    move(updated_routes, updated_routes_capacities, data_inst, m.route1, m.route2, m.idx1, m.idx2);
+}
+
+// Best delete_and_insert from delete_route into insert_route, in the scan order of
+// apply_best_delete_and_insert. delta = 1 when the pair has no feasible move.
+// With block (every route laid out) the gain kernel scores the positions of insert_route.
+move_proposal best_delete_and_insert_between( const vector< vector<int> >& updated_routes, const vector<int>& updated_routes_capacities, const instance& data_inst, int delete_route, int insert_route, const route_block* block = nullptr)
 {
     // Remember that the first element from every route is the depot
     int best_benefit = -1;
-    int best_deleted_route = -1;
     int best_deleted_index = -1;
-    int best_inserted_route = -1;
     int best_inserted_index = -1;
+    int sz_del = (int) updated_routes[delete_route].size();
+    int sz_ins = (int) updated_routes[insert_route].size();
+    if( delete_route != insert_route && block != nullptr ) {
+        // all insertion positions of insert_route are scored at once (see gain_kernel.h)
+        int from = block->begin[insert_route] + 1, to = block->begin[insert_route + 1];
+        const distance_matrix& d = data_inst.distances;
+        for(int delete_index = 1; delete_index < sz_del; ++delete_index) {
+            int cur_deleted = updated_routes[delete_route][delete_index];
+            int position;
+            int savings = best_insertion_gain(*block, from, to, d.row(cur_deleted), data_inst.uniform_vehicle_capacity - data_inst.demands[cur_deleted], position);
+            if( position < 0 ) continue;
+            int insert_index = position - block->begin[insert_route];
+            int prev_deleted = updated_routes[delete_route][delete_index - 1];
+            int next_deleted = ( delete_index == sz_del - 1 ? data_inst.depot_index : updated_routes[delete_route][delete_index + 1]);
+            savings += d.dist(prev_deleted, cur_deleted) + d.dist(cur_deleted, next_deleted) - d.dist(prev_deleted, next_deleted);
+            if( savings > best_benefit )
+            {
+                best_benefit = savings;
+                best_deleted_index = delete_index;
+                best_inserted_index = insert_index;
+            }
+        }
+        return move_proposal{DELETE_AND_INSERT, delete_route, best_deleted_index, insert_route, best_inserted_index, -best_benefit, 0};
+    }
+    for(int delete_index = 1; delete_index < sz_del; ++delete_index) {
+        for(int insert_index = 1; insert_index < sz_ins; ++insert_index) {
+            int cur_deleted = updated_routes[delete_route][delete_index];
+            if( insert_route != delete_route && updated_routes_capacities[insert_route] + data_inst.demands[ cur_deleted ] > data_inst.uniform_vehicle_capacity ) continue;
+            int savings;
+            // inside the same route the insertion index refers to the route after the deletion
+            if( insert_route == delete_route ) savings = -delete_and_insert_delta(updated_routes, delete_route, insert_route, delete_index, insert_index, data_inst);
+            else {
+                int prev_deleted = updated_routes[delete_route][delete_index - 1];
+                int next_deleted = ( delete_index == sz_del - 1 ? data_inst.depot_index : updated_routes[delete_route][delete_index + 1]);
+                savings = data_inst.distances.dist(prev_deleted, cur_deleted);
+                savings += data_inst.distances.dist(cur_deleted, next_deleted);
+                savings -= data_inst.distances.dist(prev_deleted, next_deleted);
+
+                int prev_insert = updated_routes[insert_route][insert_index - 1];
+                int next_insert = updated_routes[insert_route][insert_index];
+
+                savings += data_inst.distances.dist(prev_insert, next_insert);
+                savings -= data_inst.distances.dist(prev_insert, cur_deleted);
+                savings -= data_inst.distances.dist(cur_deleted, next_insert);
+            }
+                     
+            if( savings > best_benefit )
+            {
+                best_benefit = savings;
+                best_deleted_index = delete_index;
+                best_inserted_index = insert_index;
+            }
+        }
+    }
+    return move_proposal{DELETE_AND_INSERT, delete_route, best_deleted_index, insert_route, best_inserted_index, -best_benefit, 0};
+}
+
+// apply_best_delete_and_insert with the gain kernel: each customer is scored against every
+// insertion position of the other routes (two calls, before and after its own route, not pruned)
+move_proposal best_delete_and_insert_blocked( const vector< vector<int> >& updated_routes, const vector<int>& updated_routes_capacities, const instance& data_inst)
+{
+    thread_local route_block block;
+    block.load_routes(updated_routes, updated_routes_capacities, data_inst);
+    const distance_matrix& d = data_inst.distances;
     int total_routes = (int) updated_routes.size();
+    move_proposal best_move{DELETE_AND_INSERT, -1, -1, -1, -1, 1, 0};
     for(int delete_route = 0; delete_route < total_routes; ++delete_route) {
+        keep_best(best_move, best_delete_and_insert_between(updated_routes, updated_routes_capacities, data_inst, delete_route, delete_route));
         int sz_del = (int) updated_routes[delete_route].size();
+        int ranges[2][2] = { { 1, block.begin[delete_route] }, { block.begin[delete_route + 1] + 1, block.begin[total_routes] } };
+        for(int delete_index = 1; delete_index < sz_del; ++delete_index) {
+            int cur_deleted = updated_routes[delete_route][delete_index];
+            int prev_deleted = updated_routes[delete_route][delete_index - 1];
+            int next_deleted = ( delete_index == sz_del - 1 ? data_inst.depot_index : updated_routes[delete_route][delete_index + 1]);
+            int removal = d.dist(prev_deleted, cur_deleted) + d.dist(cur_deleted, next_deleted) - d.dist(prev_deleted, next_deleted);
+            for(const auto& range : ranges) {
+                if( range[0] >= range[1] ) continue;
+                int position;
+                int savings = best_insertion_gain(block, range[0], range[1], d.row(cur_deleted), data_inst.uniform_vehicle_capacity - data_inst.demands[cur_deleted], position);
+                if( position < 0 ) continue;
+                int insert_route = block.route[position];
+                keep_best(best_move, move_proposal{DELETE_AND_INSERT, delete_route, delete_index, insert_route, position - block.begin[insert_route], -(savings + removal), 0});
+            }
+        }
+    }
+    return best_move;
+}
+
+bool apply_best_delete_and_insert( vector< vector<int> >& updated_routes, vector<int>& updated_routes_capacities, const instance& data_inst)
+{
+    if( use_gain_kernel(data_inst) ) {
+        move_proposal best_move = best_delete_and_insert_blocked(updated_routes, updated_routes_capacities, data_inst);
+        if( best_move.delta >= 0 ) return false;
+        move(updated_routes, updated_routes_capacities, data_inst, best_move.route1, best_move.route2, best_move.idx1, best_move.idx2);
+        return true;
+    }
+    int total_routes = (int) updated_routes.size();
+    thread_local vector<route_summary> summaries;
+    bool pruning = route_pruning_enabled();
+    if( pruning ) summarize_routes(updated_routes, data_inst, summaries);
+    move_proposal best_move{DELETE_AND_INSERT, -1, -1, -1, -1, 1, 0};
+    for(int delete_route = 0; delete_route < total_routes; ++delete_route) {
         for(int insert_route = 0; insert_route < total_routes; ++insert_route) {
-            int sz_ins = (int) updated_routes[insert_route].size();
-            for(int delete_index = 1; delete_index < sz_del; ++delete_index) {
-                for(int insert_index = 1; insert_index < sz_ins; ++insert_index) {
-                    if(updated_routes_capacities[insert_route] + data_inst.demands[ updated_routes[delete_route][delete_index] ] <= data_inst.uniform_vehicle_capacity ) {
-                        int cur_deleted = updated_routes[delete_route][delete_index];
-                        int prev_deleted = updated_routes[delete_route][delete_index - 1];
-                        int next_deleted = ( delete_index == sz_del - 1 ? data_inst.depot_index : updated_routes[delete_route][delete_index + 1]);
-                        int savings = data_inst.adjacency_matrix[ prev_deleted ][ cur_deleted ];
-                        savings += data_inst.adjacency_matrix[ cur_deleted ][ next_deleted ];
-                        savings -= data_inst.adjacency_matrix[ prev_deleted ][ next_deleted ];
-
-                        int prev_insert = updated_routes[insert_route][insert_index - 1];
-                        int next_insert = updated_routes[insert_route][insert_index];
-
-                        savings += data_inst.adjacency_matrix[prev_insert][next_insert];
-                        savings -= data_inst.adjacency_matrix[prev_insert][cur_deleted];
-                        savings -= data_inst.adjacency_matrix[cur_deleted][next_insert];
-                                 
-                        if( savings > best_benefit )
-                        {
-                            best_benefit = savings;
-                            best_deleted_route = delete_route;
-                            best_deleted_index = delete_index;
-                            best_inserted_route = insert_route;
-                            best_inserted_index = insert_index;
-                        }
+            if( pruning && insert_route != delete_route && !relocation_may_improve(summaries[delete_route], summaries[insert_route]) ) continue;
+            move_proposal candidate = best_delete_and_insert_between(updated_routes, updated_routes_capacities, data_inst, delete_route, insert_route);
+            if( candidate.delta < best_move.delta ) best_move = candidate;
+        }
+    }
+    if( best_move.delta >= 0 ) return false;
+    
+    move(updated_routes, updated_routes_capacities, data_inst, best_move.route1, best_move.route2, best_move.idx1, best_move.idx2);
+    return true;
+}
+
+// MOVE CACHE
+// Pairs with fewer |route1| * |route2| candidate moves are scanned without the route_bounds.h
+// test, which costs more than such a scan (X-n101, 4 customers per route)
+constexpr int PRUNING_MIN_PAIR_SIZE = 64;
+
+// heap order: larger gain first, then the pair that comes first in the scan order
+bool cached_move_less(const cached_move& a, const cached_move& b) {
+    if (a.gain != b.gain) return a.gain < b.gain;
+    if (a.route1 != b.route1) return a.route1 > b.route1;
+    return a.route2 > b.route2;
+}
+
+void move_cache::evaluate_pair(const vector<vector<int>> &routes, const vector<int> &route_capacities, const instance& data_inst, int type, int route1, int route2) {
+    int t = (type == EXCHANGE ? 0 : 1);
+    int idx = route1 * total_routes + route2;
+    bool pruned = (route1 != route2 && route_pruning_enabled() && summaries[route1].customers * summaries[route2].customers >= PRUNING_MIN_PAIR_SIZE &&
+                   !(type == EXCHANGE ? exchange_may_improve(summaries[route1], summaries[route2]) : relocation_may_improve(summaries[route1], summaries[route2])));
+    move_proposal m = (pruned ? move_proposal{type, -1, -1, -1, -1, 1, 0}
+                              : type == EXCHANGE ? best_exchange_between(routes, route_capacities, data_inst, route1, route2, blocked ? &block : nullptr)
+                                                 : best_delete_and_insert_between(routes, route_capacities, data_inst, route1, route2, blocked ? &block : nullptr));
+    best_moves[t][idx] = m;
+    versions[t][idx]++;
+    if (m.delta < 0) {
+        heaps[t].push_back(cached_move{-m.delta, route1, route2, versions[t][idx]});
+        push_heap(heaps[t].begin(), heaps[t].end(), cached_move_less);
+    }
+}
+
+void move_cache::rebuild(const vector<vector<int>> &routes, const vector<int> &route_capacities, const instance& data_inst) {
+    total_routes = (int)routes.size();
+    summarize_routes(routes, data_inst, summaries);
+    blocked = use_gain_kernel(data_inst);
+    if (blocked) block.load_routes(routes, route_capacities, data_inst);
+    for (int t = 0; t < 2; t++) {
+        best_moves[t].assign(total_routes * total_routes, move_proposal{t == 0 ? EXCHANGE : DELETE_AND_INSERT, -1, -1, -1, -1, 1, 0});
+        versions[t].assign(total_routes * total_routes, 0);
+        heaps[t].clear();
+        stale[t].assign(total_routes, 1);
+        pending[t].clear();
+        for (int route = 0; route < total_routes; route++) pending[t].push_back(route);
+    }
+}
+
+void move_cache::mark_changed(int route) {
+    for (int t = 0; t < 2; t++) {
+        if (stale[t][route]) continue;
+        stale[t][route] = 1;
+        pending[t].push_back(route);
+    }
+}
+
+void move_cache::refresh(const vector<vector<int>> &routes, const vector<int> &route_capacities, const instance& data_inst, int type) {
+    int t = (type == EXCHANGE ? 0 : 1);
+    // stale[t][route] = 2 once the pairs of route are done, so a pair of two pending routes is scored once
+    for (int route : pending[t]) {
+        for (int other = 0; other < total_routes; other++) {
+            if (stale[t][other] == 2) continue;
+            if (type == EXCHANGE) evaluate_pair(routes, route_capacities, data_inst, EXCHANGE, min(route, other), max(route, other));
+            else {
+                evaluate_pair(routes, route_capacities, data_inst, DELETE_AND_INSERT, route, other);
+                if (other != route) evaluate_pair(routes, route_capacities, data_inst, DELETE_AND_INSERT, other, route);
+            }
+        }
+        stale[t][route] = 2;
+    }
+    for (int route : pending[t]) stale[t][route] = 0;
+    pending[t].clear();
+    // stale entries are dropped once they dominate the heap
+    if ((int)heaps[t].size() <= 4 * total_routes * total_routes) return;
+    heaps[t].clear();
+    for (int idx = 0; idx < total_routes * total_routes; idx++) {
+        if (best_moves[t][idx].delta < 0) heaps[t].push_back(cached_move{-best_moves[t][idx].delta, idx / total_routes, idx % total_routes, versions[t][idx]});
+    }
+    make_heap(heaps[t].begin(), heaps[t].end(), cached_move_less);
+}
+
+move_proposal move_cache::best(const vector<vector<int>> &routes, const vector<int> &route_capacities, const instance& data_inst, int type) {
+    int t = (type == EXCHANGE ? 0 : 1);
+    if (!pending[t].empty()) refresh(routes, route_capacities, data_inst, type);
+    while (!heaps[t].empty()) {
+        const cached_move& top = heaps[t].front();
+        int idx = top.route1 * total_routes + top.route2;
+        if (top.version == versions[t][idx]) return best_moves[t][idx];
+        pop_heap(heaps[t].begin(), heaps[t].end(), cached_move_less);
+        heaps[t].pop_back();
+    }
+    return move_proposal{type, -1, -1, -1, -1, 1, 0};
+}
+
+bool move_cache::apply_best(vector<vector<int>> &routes, vector<int> &route_capacities, const instance& data_inst, int type, uint64_t* hash) {
+    move_proposal m = best(routes, route_capacities, data_inst, type);
+    if (m.delta >= 0) return false;
+    if (hash != nullptr) *hash += move_hash_delta(routes, m, data_inst);
+    int routes_before = (int)routes.size();
+    if (type == EXCHANGE) apply_exchange(routes, route_capacities, m, data_inst);
+    else move(routes, route_capacities, data_inst, m.route1, m.route2, m.idx1, m.idx2);
+
+    if ((int)routes.size() != routes_before) rebuild(routes, route_capacities, data_inst);
+    else {
+        summaries[m.route1] = summarize_route(routes[m.route1], data_inst);
+        summaries[m.route2] = summarize_route(routes[m.route2], data_inst);
+        if (blocked) block.reload_routes(routes, route_capacities, data_inst, m.route1, m.route2);
+        mark_changed(m.route1);
+        mark_changed(m.route2);
+    }
+    return true;
+}
+
+// GRANULAR NEIGHBORHOODS
+// Only moves that place a customer next to one of its k nearest neighbors are
+// evaluated, so each scan costs O(n * k) instead of O(n^2)
+void city_locations::locate(const vector<vector<int>> &routes, int dimension) {
+    route_of.assign(dimension, -1);
+    position_of.assign(dimension, -1);
+    total_routes = (int)routes.size();
+    for (int r = 0; r < total_routes; r++) locate_route(routes, r);
+}
+
+void city_locations::locate_route(const vector<vector<int>> &routes, int route) {
+    for (int i = 1; i < (int)routes[route].size(); i++) {
+        route_of[routes[route][i]] = route;
+        position_of[routes[route][i]] = i;
+    }
+}
+
+void city_locations::relocate(const vector<vector<int>> &routes, int route1, int route2) {
+    // an emptied route was erased: every route after it changed its index
+    if ((int)routes.size() != total_routes) {
+        locate(routes, (int)route_of.size());
+        return;
+    }
+    locate_route(routes, route1);
+    if (route2 != route1) locate_route(routes, route2);
+}
+
+bool apply_best_exchange_granular(vector<vector<int>> &updated_routes, vector<int> &updated_route_capacities, const instance& data_inst, int k, city_locations& locations) {
+    const vector<int>& route_of = locations.route_of;
+    const vector<int>& position_of = locations.position_of;
+
+    int best_benefit = -1;
+    move_proposal best_move{EXCHANGE, -1, -1, -1, -1, 0, 0};
+    for (int first_route = 0; first_route < (int)updated_routes.size(); first_route++) {
+        for (int first_index = 1; first_index < (int)updated_routes[first_route].size(); first_index++) {
+            int F = updated_routes[first_route][first_index];
+            const vector<int>& neighbors = data_inst.nearest_neighbors[F];
+            int limit = min(k, (int)neighbors.size());
+            for (int t = 0; t < limit; t++) {
+                int second_route = route_of[neighbors[t]];
+                // F becomes adjacent to the neighbor by taking the place of its predecessor or successor
+                for (int second_index = position_of[neighbors[t]] - 1; second_index <= position_of[neighbors[t]] + 1; second_index += 2) {
+                    if (second_index < 1 || second_index >= (int)updated_routes[second_route].size()) continue;
+                    if (first_route == second_route && first_index == second_index) continue;
+                    if (first_route != second_route) {
+                        int S = updated_routes[second_route][second_index];
+                        int upd_cap_fst = updated_route_capacities[first_route] - data_inst.demands[F] + data_inst.demands[S];
+                        int upd_cap_snd = updated_route_capacities[second_route] - data_inst.demands[S] + data_inst.demands[F];
+                        if (max(upd_cap_fst, upd_cap_snd) > data_inst.uniform_vehicle_capacity) continue;
+                    }
+                    int gain = -exchange_delta(updated_routes, first_route, second_route, first_index, second_index, data_inst);
+                    if (gain > best_benefit) {
+                        best_benefit = gain;
+                        best_move = move_proposal{EXCHANGE, first_route, first_index, second_route, second_index, -gain, 0};
                     }
                 }
             }
         }
     }
-    if( best_benefit <= 0) return false;
-    else {
-        if( best_deleted_route != best_inserted_route || best_deleted_index != best_inserted_index) {
-            move(updated_routes, updated_routes_capacities, data_inst, best_deleted_route, best_inserted_route, best_deleted_index, best_inserted_index);
-            return true;
+    if (best_benefit <= 0) return false;
+    
+    apply_exchange(updated_routes, updated_route_capacities, best_move, data_inst);
+    locations.relocate(updated_routes, best_move.route1, best_move.route2);
+    return true;
+}
+
+bool apply_best_delete_and_insert_granular(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const instance& data_inst, int k, city_locations& locations) {
+    const vector<int>& route_of = locations.route_of;
+    const vector<int>& position_of = locations.position_of;
+
+    int best_benefit = -1;
+    move_proposal best_move{DELETE_AND_INSERT, -1, -1, -1, -1, 0, 0};
+    for (int delete_route = 0; delete_route < (int)updated_routes.size(); delete_route++) {
+        for (int delete_index = 1; delete_index < (int)updated_routes[delete_route].size(); delete_index++) {
+            int city = updated_routes[delete_route][delete_index];
+            const vector<int>& neighbors = data_inst.nearest_neighbors[city];
+            int limit = min(k, (int)neighbors.size());
+            for (int t = 0; t < limit; t++) {
+                int insert_route = route_of[neighbors[t]];
+                if (insert_route != delete_route &&
+                    updated_routes_capacities[insert_route] + data_inst.demands[city] > data_inst.uniform_vehicle_capacity) continue;
+                // insert the city right before or right after the neighbor
+                for (int insert_index = position_of[neighbors[t]]; insert_index <= position_of[neighbors[t]] + 1; insert_index++) {
+                    int idx_ins = insert_index;
+                    if (insert_route == delete_route && idx_ins > delete_index) idx_ins--; // index after the deletion
+                    if (insert_route == delete_route && idx_ins == delete_index) continue;
+                    int gain = -delete_and_insert_delta(updated_routes, delete_route, insert_route, delete_index, idx_ins, data_inst);
+                    if (gain > best_benefit) {
+                        best_benefit = gain;
+                        best_move = move_proposal{DELETE_AND_INSERT, delete_route, delete_index, insert_route, idx_ins, -gain, 0};
+                    }
+                }
+            }
         }
     }
-    return false; // just to avoid warning
+    if (best_benefit <= 0) return false;
+    
+    move(updated_routes, updated_routes_capacities, data_inst, best_move.route1, best_move.route2, best_move.idx1, best_move.idx2);
+    locations.relocate(updated_routes, best_move.route1, best_move.route2);
+    return true;
 }
 
 // 2-OPT
@@ -224,8 +656,8 @@ j+1 i+1 -           j+1 <-- i+1 <-
   /\     |                        |
  i  j <--              i --> j ---
 */
-void two_opt(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, instance data_inst) {
-    int idx = rand() % updated_routes.size();
+void two_opt(vector<vector<int>> &updated_routes, vector<int> & /* updated_routes_capacities: same signature as exchange, loads do not change */, const instance& data_inst, mt19937& rng) {
+    int idx = rng() % updated_routes.size();
     
     vector<int> route(updated_routes[idx]);
 
@@ -246,7 +678,333 @@ void two_opt(vector<vector<int>> &updated_routes, vector<int> &updated_routes_ca
     updated_routes[idx] = route;
 }
 
-neighborhood_generator::neighborhood_generator(instance inst) { 
+// Single step of two_opt: swap the cities at positions i+1 and i+2 of a random route
+move_proposal propose_two_opt(const vector<vector<int>> &routes, const instance& data_inst, mt19937& rng) {
+    int idx = rng() % routes.size();
+    int sz = (int)routes[idx].size();
+    if (sz < 4) return move_proposal{TWO_OPT, idx, -1, idx, -1, 0, 0}; // route too short, nothing to swap
+    int i = (rng() % (sz - 3)) + 1;
+    return move_proposal{TWO_OPT, idx, i + 1, idx, i + 2, exchange_delta(routes, idx, idx, i + 1, i + 2, data_inst), 0};
+}
+
+// 2-OPT (SEGMENT REVERSAL), OR-OPT AND 2-OPT*
+// load_prefix[i] is the demand of route[1..i], so the load of any segment or
+// route tail is a difference of two entries and every delta below is O(1)
+void load_prefix(const vector<int>& route, const instance& data_inst, vector<int>& prefix) {
+    prefix.resize(route.size());
+    prefix[0] = 0;
+    for (int i = 1; i < (int)route.size(); i++) prefix[i] = prefix[i - 1] + data_inst.demands[route[i]];
+}
+
+// load_prefix of every route, in a buffer reused by the scans of this thread: its rows keep their
+// capacity (it never shrinks), so the scans of a descent do not allocate once it has grown
+const vector<vector<int>>& load_prefixes_of(const vector<vector<int>> &routes, const instance& data_inst) {
+    thread_local vector<vector<int>> prefixes;
+    if (prefixes.size() < routes.size()) prefixes.resize(routes.size());
+    for (int r = 0; r < (int)routes.size(); r++) load_prefix(routes[r], data_inst, prefixes[r]);
+    return prefixes;
+}
+
+// Exact variation of reversing routes[r][i..j] (1 <= i < j)
+template<class weight>
+typename weight::value two_opt_reversal_change(const vector<vector<int>> &routes, int r, int i, int j, const instance& data_inst, const weight& w) {
+    const vector<int>& route = routes[r];
+    int prev = route[i - 1], next = next_node(route, j, data_inst);
+    return w(prev, route[j]) + w(route[i], next) - w(prev, route[i]) - w(route[j], next);
+}
+
+int two_opt_reversal_delta(const vector<vector<int>> &routes, int r, int i, int j, const instance& data_inst) {
+    return two_opt_reversal_change(routes, r, i, j, data_inst, edge_distance{data_inst.distances});
+}
+
+// Exact variation of moving the len customers starting at routes[route_del][idx_del]
+// to position idx_ins of route_ins (as in delete_and_insert, indices after the removal)
+template<class weight>
+typename weight::value or_opt_change(const vector<vector<int>> &routes, int route_del, int idx_del, int len, int route_ins, int idx_ins, const instance& data_inst, const weight& w) {
+    const vector<int>& del = routes[route_del];
+    const vector<int>& ins = routes[route_ins];
+    int first = del[idx_del], last = del[idx_del + len - 1];
+    int prev_del = del[idx_del - 1], next_del = next_node(del, idx_del + len - 1, data_inst);
+
+    // an emptied route is erased by apply_or_opt, which costs nothing more since d(depot, depot) = 0
+    typename weight::value delta = w(prev_del, next_del) - w(prev_del, first) - w(last, next_del);
+
+    int prev_ins, next_ins;
+    if (route_del != route_ins) {
+        prev_ins = ins[idx_ins - 1];
+        next_ins = (idx_ins == (int)ins.size() ? data_inst.depot_index : ins[idx_ins]);
+    }
+    else {
+        auto reduced = [&] (int k) { return (k < idx_del ? del[k] : del[k + len]); };
+        prev_ins = reduced(idx_ins - 1);
+        next_ins = (idx_ins == (int)del.size() - len ? data_inst.depot_index : reduced(idx_ins));
+    }
+    delta += w(prev_ins, first) + w(last, next_ins) - w(prev_ins, next_ins);
+    return delta;
+}
+
+int or_opt_delta(const vector<vector<int>> &routes, int route_del, int idx_del, int len, int route_ins, int idx_ins, const instance& data_inst) {
+    return or_opt_change(routes, route_del, idx_del, len, route_ins, idx_ins, data_inst, edge_distance{data_inst.distances});
+}
+
+// Exact variation of exchanging the tails after positions cut1 of route1 and cut2 of route2
+template<class weight>
+typename weight::value two_opt_star_change(const vector<vector<int>> &routes, int route1, int cut1, int route2, int cut2, const instance& data_inst, const weight& w) {
+    int x = routes[route1][cut1], next_x = next_node(routes[route1], cut1, data_inst);
+    int y = routes[route2][cut2], next_y = next_node(routes[route2], cut2, data_inst);
+    return w(x, next_y) + w(y, next_x) - w(x, next_x) - w(y, next_y);
+}
+
+int two_opt_star_delta(const vector<vector<int>> &routes, int route1, int cut1, int route2, int cut2, const instance& data_inst) {
+    return two_opt_star_change(routes, route1, cut1, route2, cut2, data_inst, edge_distance{data_inst.distances});
+}
+
+uint64_t move_hash_delta(const vector<vector<int>> &routes, const move_proposal& m, const instance& data_inst) {
+    if (m.idx1 < 0) return 0; // empty proposal
+    edge_zobrist key;
+    if (m.type == DELETE_AND_INSERT) return delete_and_insert_change(routes, m.route1, m.route2, m.idx1, m.idx2, data_inst, key);
+    if (m.type == TWO_OPT_REVERSAL) return two_opt_reversal_change(routes, m.route1, m.idx1, m.idx2, data_inst, key);
+    if (m.type == OR_OPT) return or_opt_change(routes, m.route1, m.idx1, m.length, m.route2, m.idx2, data_inst, key);
+    if (m.type == TWO_OPT_STAR) return two_opt_star_change(routes, m.route1, m.idx1, m.route2, m.idx2, data_inst, key);
+    return exchange_change(routes, m.route1, m.route2, m.idx1, m.idx2, data_inst, key); // EXCHANGE and TWO_OPT
+}
+
+int max_route_length(const instance& data_inst) {
+    vector<int> demands;
+    for (int v = 0; v < data_inst.dimension; v++)
+        if (v != data_inst.depot_index) demands.push_back(data_inst.demands[v]);
+    sort(demands.begin(), demands.end());
+    int length = 1, load = 0;
+    for (int demand : demands) {
+        if (load + demand > data_inst.uniform_vehicle_capacity) break;
+        load += demand;
+        length++;
+    }
+    return length;
+}
+
+void reserve_routes(vector<vector<int>> &routes, const instance& data_inst) {
+    int length = max_route_length(data_inst);
+    for (vector<int>& route : routes) route.reserve(length);
+}
+
+// Routes reduced to the depot are erased, the highest index first so the other one stays valid
+void erase_empty_routes(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, int route1, int route2) {
+    if (route1 < route2) swap(route1, route2);
+    for (int r : {route1, route2}) {
+        if (r >= 0 && updated_routes[r].size() == 1) {
+            updated_routes.erase(updated_routes.begin() + r);
+            updated_routes_capacities.erase(updated_routes_capacities.begin() + r);
+        }
+    }
+}
+
+void apply_two_opt_reversal(vector<vector<int>> &updated_routes, const move_proposal& m) {
+    if (m.idx1 < 0) return;
+    reverse(updated_routes[m.route1].begin() + m.idx1, updated_routes[m.route1].begin() + m.idx2 + 1);
+}
+
+void apply_or_opt(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const move_proposal& m, const instance& data_inst) {
+    if (m.idx1 < 0) return;
+    vector<int>& del = updated_routes[m.route1];
+    int segment[3], load = 0;
+    for (int k = 0; k < m.length; k++) {
+        segment[k] = del[m.idx1 + k];
+        load += data_inst.demands[segment[k]];
+    }
+    del.erase(del.begin() + m.idx1, del.begin() + m.idx1 + m.length);
+    vector<int>& ins = updated_routes[m.route2];
+    ins.insert(ins.begin() + m.idx2, segment, segment + m.length);
+    if (m.route1 != m.route2) {
+        updated_routes_capacities[m.route1] -= load;
+        updated_routes_capacities[m.route2] += load;
+        erase_empty_routes(updated_routes, updated_routes_capacities, m.route1, -1);
+    }
+}
+
+void apply_two_opt_star(vector<vector<int>> &updated_routes, vector<int> &updated_routes_capacities, const move_proposal& m, const instance& data_inst) {
+    if (m.idx1 < 0) return;
+    vector<int>& fst = updated_routes[m.route1];
+    vector<int>& snd = updated_routes[m.route2];
+    int tail_load_fst = 0, tail_load_snd = 0;
+    for (int i = m.idx1 + 1; i < (int)fst.size(); i++) tail_load_fst += data_inst.demands[fst[i]];
+    for (int i = m.idx2 + 1; i < (int)snd.size(); i++) tail_load_snd += data_inst.demands[snd[i]];
+    thread_local vector<int> tail_fst; // reused, the swap does not allocate once it has grown
+    tail_fst.assign(fst.begin() + m.idx1 + 1, fst.end());
+    fst.resize(m.idx1 + 1);
+    fst.insert(fst.end(), snd.begin() + m.idx2 + 1, snd.end());
+    snd.resize(m.idx2 + 1);
+    snd.insert(snd.end(), tail_fst.begin(), tail_fst.end());
+    updated_routes_capacities[m.route1] += tail_load_snd - tail_load_fst;
+    updated_routes_capacities[m.route2] += tail_load_fst - tail_load_snd;
+    erase_empty_routes(updated_routes, updated_routes_capacities, m.route1, m.route2);
+}
+
+// Random proposals give up after a few infeasible draws and return an empty move (idx1 = -1)
+const int MAX_PROPOSAL_ATTEMPTS = 100;
+
+move_proposal propose_two_opt_reversal(const vector<vector<int>> &routes, const instance& data_inst, mt19937& rng) {
+    int r = rng() % routes.size();
+    int sz = (int)routes[r].size();
+    if (sz < 3) return move_proposal{TWO_OPT_REVERSAL, r, -1, r, -1, 0, 0};
+    int i = (rng() % (sz - 1)) + 1;
+    int j = (rng() % (sz - 2)) + 1;
+    if (j >= i) j++;
+    if (i > j) swap(i, j);
+    return move_proposal{TWO_OPT_REVERSAL, r, i, r, j, two_opt_reversal_delta(routes, r, i, j, data_inst), 0};
+}
+
+move_proposal propose_or_opt(const vector<vector<int>> &routes, const vector<int> &routes_capacities, const instance& data_inst, mt19937& rng) {
+    for (int attempt = 0; attempt < MAX_PROPOSAL_ATTEMPTS; attempt++) {
+        int route_del = rng() % routes.size();
+        int route_ins = rng() % routes.size();
+        int len = (rng() % 3) + 1;
+        int customers = (int)routes[route_del].size() - 1;
+        if (len > customers) continue;
+        int idx_del = (rng() % (customers - len + 1)) + 1;
+        int idx_ins;
+        if (route_del == route_ins) {
+            if (customers == len) continue;
+            idx_ins = (rng() % (customers - len + 1)) + 1;
+            if (idx_ins == idx_del) continue;
+        }
+        else {
+            int load = 0;
+            for (int k = 0; k < len; k++) load += data_inst.demands[routes[route_del][idx_del + k]];
+            if (routes_capacities[route_ins] + load > data_inst.uniform_vehicle_capacity) continue;
+            idx_ins = (rng() % routes[route_ins].size()) + 1;
+        }
+        return move_proposal{OR_OPT, route_del, idx_del, route_ins, idx_ins, or_opt_delta(routes, route_del, idx_del, len, route_ins, idx_ins, data_inst), len};
+    }
+    return move_proposal{OR_OPT, 0, -1, 0, -1, 0, 0};
+}
+
+// With prefixes (load_prefix of every route) the capacity check is O(1), else the heads are summed
+move_proposal propose_two_opt_star(const vector<vector<int>> &routes, const vector<int> &routes_capacities, const instance& data_inst, mt19937& rng, const vector<vector<int>>* prefixes = nullptr) {
+    if (routes.size() < 2) return move_proposal{TWO_OPT_STAR, 0, -1, 0, -1, 0, 0};
+    for (int attempt = 0; attempt < MAX_PROPOSAL_ATTEMPTS; attempt++) {
+        int route1 = rng() % routes.size();
+        int route2 = rng() % routes.size();
+        if (route1 == route2) continue;
+        int sz1 = (int)routes[route1].size(), sz2 = (int)routes[route2].size();
+        int cut1 = rng() % sz1, cut2 = rng() % sz2;
+        if ((cut1 == 0 && cut2 == 0) || (cut1 == sz1 - 1 && cut2 == sz2 - 1)) continue; // same pair of routes
+        int head1 = 0, head2 = 0;
+        if (prefixes != nullptr) {
+            head1 = (*prefixes)[route1][cut1];
+            head2 = (*prefixes)[route2][cut2];
+        }
+        else {
+            for (int i = 1; i <= cut1; i++) head1 += data_inst.demands[routes[route1][i]];
+            for (int i = 1; i <= cut2; i++) head2 += data_inst.demands[routes[route2][i]];
+        }
+        if (head1 + routes_capacities[route2] - head2 > data_inst.uniform_vehicle_capacity ||
+            head2 + routes_capacities[route1] - head1 > data_inst.uniform_vehicle_capacity) continue;
+        return move_proposal{TWO_OPT_STAR, route1, cut1, route2, cut2, two_opt_star_delta(routes, route1, cut1, route2, cut2, data_inst), 0};
+    }
+    return move_proposal{TWO_OPT_STAR, 0, -1, 0, -1, 0, 0};
+}
+
+// A reversal stays inside its route, so no load changes: the capacities are taken only to keep the
+// signature of the other apply_best_* operators, which the descents call interchangeably
+bool apply_best_two_opt(vector<vector<int>> &updated_routes, vector<int> & /* updated_route_capacities */, const instance& data_inst) {
+    int best_benefit = 0;
+    move_proposal best_move{TWO_OPT_REVERSAL, -1, -1, -1, -1, 0, 0};
+    for (int r = 0; r < (int)updated_routes.size(); r++) {
+        int sz = (int)updated_routes[r].size();
+        for (int i = 1; i < sz - 1; i++) {
+            for (int j = i + 1; j < sz; j++) {
+                int gain = -two_opt_reversal_delta(updated_routes, r, i, j, data_inst);
+                if (gain > best_benefit) {
+                    best_benefit = gain;
+                    best_move = move_proposal{TWO_OPT_REVERSAL, r, i, r, j, -gain, 0};
+                }
+            }
+        }
+    }
+    if (best_benefit <= 0) return false;
+
+    apply_two_opt_reversal(updated_routes, best_move);
+    return true;
+}
+
+bool apply_best_or_opt(vector<vector<int>> &updated_routes, vector<int> &updated_route_capacities, const instance& data_inst) {
+    int total_routes = (int)updated_routes.size();
+    const vector<vector<int>>& prefix = load_prefixes_of(updated_routes, data_inst);
+
+    int best_benefit = 0;
+    move_proposal best_move{OR_OPT, -1, -1, -1, -1, 0, 0};
+    for (int route_del = 0; route_del < total_routes; route_del++) {
+        int sz_del = (int)updated_routes[route_del].size();
+        for (int len = 1; len <= 3; len++) {
+            for (int idx_del = 1; idx_del + len <= sz_del; idx_del++) {
+                int load = prefix[route_del][idx_del + len - 1] - prefix[route_del][idx_del - 1];
+                for (int route_ins = 0; route_ins < total_routes; route_ins++) {
+                    int positions; // valid insertion indices are 1..positions
+                    if (route_ins == route_del) positions = sz_del - len;
+                    else {
+                        if (updated_route_capacities[route_ins] + load > data_inst.uniform_vehicle_capacity) continue;
+                        positions = (int)updated_routes[route_ins].size();
+                    }
+                    for (int idx_ins = 1; idx_ins <= positions; idx_ins++) {
+                        if (route_ins == route_del && idx_ins == idx_del) continue;
+                        int gain = -or_opt_delta(updated_routes, route_del, idx_del, len, route_ins, idx_ins, data_inst);
+                        if (gain > best_benefit) {
+                            best_benefit = gain;
+                            best_move = move_proposal{OR_OPT, route_del, idx_del, route_ins, idx_ins, -gain, len};
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (best_benefit <= 0) return false;
+
+    apply_or_opt(updated_routes, updated_route_capacities, best_move, data_inst);
+    return true;
+}
+
+bool apply_best_two_opt_star(vector<vector<int>> &updated_routes, vector<int> &updated_route_capacities, const instance& data_inst) {
+    int total_routes = (int)updated_routes.size();
+    const vector<vector<int>>& prefix = load_prefixes_of(updated_routes, data_inst);
+
+    int best_benefit = 0;
+    move_proposal best_move{TWO_OPT_STAR, -1, -1, -1, -1, 0, 0};
+    for (int route1 = 0; route1 < total_routes; route1++) {
+        int sz1 = (int)updated_routes[route1].size();
+        for (int route2 = route1 + 1; route2 < total_routes; route2++) {
+            int sz2 = (int)updated_routes[route2].size();
+            for (int cut1 = 0; cut1 < sz1; cut1++) {
+                for (int cut2 = 0; cut2 < sz2; cut2++) {
+                    int head1 = prefix[route1][cut1], head2 = prefix[route2][cut2];
+                    if (head1 + updated_route_capacities[route2] - head2 > data_inst.uniform_vehicle_capacity ||
+                        head2 + updated_route_capacities[route1] - head1 > data_inst.uniform_vehicle_capacity) continue;
+                    int gain = -two_opt_star_delta(updated_routes, route1, cut1, route2, cut2, data_inst);
+                    if (gain > best_benefit) {
+                        best_benefit = gain;
+                        best_move = move_proposal{TWO_OPT_STAR, route1, cut1, route2, cut2, -gain, 0};
+                    }
+                }
+            }
+        }
+    }
+    if (best_benefit <= 0) return false;
+
+    apply_two_opt_star(updated_routes, updated_route_capacities, best_move, data_inst);
+    return true;
+}
+
+// Random proposal of the given neighborhood (see move_type)
+move_proposal propose_of_type(int type, const vector<vector<int>> &routes, const vector<int> &routes_capacities, const instance& data_inst, mt19937& rng, const vector<vector<int>>* prefixes = nullptr) {
+    if (type == EXCHANGE) return propose_exchange(routes, routes_capacities, data_inst, rng);
+    if (type == DELETE_AND_INSERT) return propose_delete_and_insert(routes, routes_capacities, data_inst, rng);
+    if (type == TWO_OPT_REVERSAL) return propose_two_opt_reversal(routes, data_inst, rng);
+    if (type == OR_OPT) return propose_or_opt(routes, routes_capacities, data_inst, rng);
+    if (type == TWO_OPT_STAR) return propose_two_opt_star(routes, routes_capacities, data_inst, rng, prefixes);
+    return propose_two_opt(routes, data_inst, rng);
+}
+
+neighborhood_generator::neighborhood_generator(shared_ptr<const instance> inst) { 
   data_inst = inst;
 }
 
@@ -267,51 +1025,145 @@ neighborhood_generator::neighborhood_generator() { }
  * - Reverse: reverse visitation order in a part of a route
  */
 void neighborhood_generator::update_solution(vector<vector<int>> &updated_routes, vector<int> &updated_route_capacities) {
-    int type = rand() % 3;
+    forget_loads(updated_routes);
+    forget_cities(updated_routes);
+    int type = rng() % 3;
     switch(type) {
         case 0:
-            exchange(updated_routes, updated_route_capacities, data_inst);
+            exchange(updated_routes, updated_route_capacities, *data_inst, rng);
         case 1:
-            delete_and_insert(updated_routes, updated_route_capacities, data_inst);
+            delete_and_insert(updated_routes, updated_route_capacities, *data_inst, rng);
         case 2:
-            two_opt(updated_routes, updated_route_capacities, data_inst);
+            two_opt(updated_routes, updated_route_capacities, *data_inst, rng);
     }
 }
 
 bool neighborhood_generator::update_solution_best_improvement( vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities) {
-    int nei = rand() % 2;
-    if(nei == 0) {
-        return apply_best_exchange(updated_routes, updated_route_capacities, data_inst);    
+    static const vector<int> default_neighborhoods = { EXCHANGE, DELETE_AND_INSERT };
+    return update_solution_best_improvement(updated_routes, updated_route_capacities, default_neighborhoods);
+}
+
+// Same choice of neighborhood as above, with the best move taken from the cache (rebuilt by the
+// caller at the start of the descent). The granular lists are not cached.
+bool neighborhood_generator::update_solution_best_improvement( vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, move_cache& cache, uint64_t* hash) {
+    forget_loads(updated_routes);
+    forget_cities(updated_routes);
+    int nei = (rng() % 2 == 0 ? EXCHANGE : DELETE_AND_INSERT);
+    bool improved = cache.apply_best(updated_routes, updated_route_capacities, *data_inst, nei, hash);
+    INSTRUMENT( record_scan(nei, improved); )
+    return improved;
+}
+
+// Applies the best move of one of the neighborhoods in neighborhood_indices, chosen at random.
+// TWO_OPT is served by the segment reversal, whose length 2 segments are exactly its swaps.
+bool neighborhood_generator::update_solution_best_improvement( vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, const vector<int>& neighborhood_indices) {
+    forget_loads(updated_routes);
+    int nei = neighborhood_indices[ rng() % neighborhood_indices.size() ];
+    bool granular = (granular_neighbors > 0 && (nei == EXCHANGE || nei == DELETE_AND_INSERT));
+    if(granular && &updated_routes != located_routes) locate_cities(updated_routes);
+    bool improved;
+    if(nei == EXCHANGE) {
+        if(granular) improved = apply_best_exchange_granular(updated_routes, updated_route_capacities, *data_inst, granular_neighbors, locations);
+        else improved = apply_best_exchange(updated_routes, updated_route_capacities, *data_inst);
     }
+    else if(nei == DELETE_AND_INSERT) {
+        if(granular) improved = apply_best_delete_and_insert_granular(updated_routes, updated_route_capacities, *data_inst, granular_neighbors, locations);
+        else improved = apply_best_delete_and_insert(updated_routes, updated_route_capacities, *data_inst);
+    }
+    else if(nei == OR_OPT) improved = apply_best_or_opt(updated_routes, updated_route_capacities, *data_inst);
+    else if(nei == TWO_OPT_STAR) improved = apply_best_two_opt_star(updated_routes, updated_route_capacities, *data_inst);
     else {
-        return apply_best_delete_and_insert(updated_routes, updated_route_capacities, data_inst);
+        nei = TWO_OPT_REVERSAL;
+        improved = apply_best_two_opt(updated_routes, updated_route_capacities, *data_inst);
     }
-    return false;
+    if(!granular && improved) forget_cities(updated_routes);
+    INSTRUMENT( record_scan(nei, improved); )
+    return improved;
 }
 
 void neighborhood_generator::update_solution_deterministic(vector<vector<int>>& updated_routes, vector<int>& updated_route_capacities, int n_type) 
 {
+    forget_loads(updated_routes);
+    forget_cities(updated_routes);
     switch(n_type) {
         case 0:
-            exchange(updated_routes, updated_route_capacities, data_inst);
+            exchange(updated_routes, updated_route_capacities, *data_inst, rng);
         case 1:
-            delete_and_insert(updated_routes, updated_route_capacities, data_inst);
+            delete_and_insert(updated_routes, updated_route_capacities, *data_inst, rng);
         case 2:
-            two_opt(updated_routes, updated_route_capacities, data_inst);
+            two_opt(updated_routes, updated_route_capacities, *data_inst, rng);
     }
 }
 
+// k > 0 restricts best improvement to the k nearest neighbors of each customer, k = 0 scans everything
+void neighborhood_generator::set_granular(int k) {
+    granular_neighbors = k;
+}
+
 void neighborhood_generator::set_seed(int s) {
     seed = s;
-    srand(seed);
+    rng.seed(seed);
 }
 
 void neighborhood_generator::update_solution_custom(vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, vector<int>& neighborhood_indices)
 {
+    forget_loads(updated_routes);
+    forget_cities(updated_routes);
     int distinct_neighborhoods = (int) neighborhood_indices.size();
-    int gen = ( rand() % distinct_neighborhoods );
+    int gen = ( rng() % distinct_neighborhoods );
     int v = neighborhood_indices[gen];
-    if( v == 0) exchange( updated_routes, updated_route_capacities, data_inst );
-    else if( v == 1 ) delete_and_insert( updated_routes, updated_route_capacities, data_inst);
-    else two_opt( updated_routes, updated_route_capacities, data_inst);
+    if( v == 0) exchange( updated_routes, updated_route_capacities, *data_inst, rng);
+    else if( v == 1 ) delete_and_insert( updated_routes, updated_route_capacities, *data_inst, rng);
+    else if( v == 2 ) two_opt( updated_routes, updated_route_capacities, *data_inst, rng);
+    else apply_move( updated_routes, updated_route_capacities, propose_of_type(v, updated_routes, updated_route_capacities, *data_inst, rng) );
+}
+
+
+move_proposal neighborhood_generator::propose_move(const vector< vector<int> >& routes, const vector<int>& route_capacities)
+{
+    int type = rng() % 3;
+    move_proposal m = propose_of_type(type, routes, route_capacities, *data_inst, rng, &routes == tracked_routes ? &load_prefixes : nullptr);
+    INSTRUMENT( record_proposal(m.type); )
+    return m;
+}
+
+move_proposal neighborhood_generator::propose_move_custom(const vector< vector<int> >& routes, const vector<int>& route_capacities, const vector<int>& neighborhood_indices)
+{
+    int distinct_neighborhoods = (int) neighborhood_indices.size();
+    int v = neighborhood_indices[ rng() % distinct_neighborhoods ];
+    move_proposal m = propose_of_type(v, routes, route_capacities, *data_inst, rng, &routes == tracked_routes ? &load_prefixes : nullptr);
+    INSTRUMENT( record_proposal(m.type); )
+    return m;
+}
+
+// Commits a proposal; only the routes referenced by the move are touched
+void neighborhood_generator::apply_move(vector< vector<int> >& routes, vector<int>& route_capacities, const move_proposal& m)
+{
+    INSTRUMENT( record_applied(m.type, m.delta); )
+    if (m.type == DELETE_AND_INSERT) move(routes, route_capacities, *data_inst, m.route1, m.route2, m.idx1, m.idx2);
+    else if (m.type == TWO_OPT_REVERSAL) apply_two_opt_reversal(routes, m);
+    else if (m.type == OR_OPT) apply_or_opt(routes, route_capacities, m, *data_inst);
+    else if (m.type == TWO_OPT_STAR) apply_two_opt_star(routes, route_capacities, m, *data_inst);
+    else apply_exchange(routes, route_capacities, m, *data_inst);
+    forget_cities(routes);
+    if (&routes != tracked_routes) return;
+    // only the two routes of the move changed, unless one of them was emptied and erased
+    if (routes.size() != load_prefixes.size()) track_loads(routes);
+    else {
+        load_prefix(routes[m.route1], *data_inst, load_prefixes[m.route1]);
+        load_prefix(routes[m.route2], *data_inst, load_prefixes[m.route2]);
+    }
+}
+
+void neighborhood_generator::locate_cities(const vector< vector<int> >& routes)
+{
+    located_routes = &routes;
+    locations.locate(routes, data_inst->dimension);
+}
+
+void neighborhood_generator::track_loads(const vector< vector<int> >& routes)
+{
+    tracked_routes = &routes;
+    load_prefixes.resize(routes.size());
+    for (int r = 0; r < (int)routes.size(); r++) load_prefix(routes[r], *data_inst, load_prefixes[r]);
 }
@@ -5,18 +5,163 @@
 #include <vector>
 #include <algorithm>
 #include <cstdio>
+#include <memory>
+#include <random>
+#include <cstdint>
 #include "data_loader.h"
+#include "cost_evaluator.h"
+#include "route_bounds.h"
+#include "gain_kernel.h"
+
+// Move types understood by propose_move / apply_move. The values match the
+// ones used in neighborhood_indices by update_solution_custom.
+// TWO_OPT is the original swap of positions i+1 and i+2; TWO_OPT_REVERSAL is the real
+// intra-route 2-opt, OR_OPT moves a segment of 1 to 3 customers and TWO_OPT_STAR swaps route tails.
+enum move_type { EXCHANGE = 0, DELETE_AND_INSERT = 1, TWO_OPT = 2, TWO_OPT_REVERSAL = 3, OR_OPT = 4, TWO_OPT_STAR = 5 };
+
+// A neighbor of the current solution, described only by the positions it
+// touches, together with the exact variation of the total cost it causes.
+// Nothing is changed in the solution until apply_move is called.
+struct move_proposal {
+    int type;
+    int route1, idx1; // exchange: first customer | delete_and_insert, or_opt: (first) moved customer
+                      // reversal: first reversed position | 2-opt*: the tail after idx1 is swapped
+    int route2, idx2; // exchange: second customer | delete_and_insert, or_opt: insertion position
+                      // reversal: last reversed position | 2-opt*: the tail after idx2 is swapped
+    int delta;        // cost(after) - cost(before)
+    int length;       // or_opt: number of customers moved
+};
+
+// Route and position of every customer, for the granular scans. They are located once, and the
+// scans then update them in place for the two routes of each move they apply.
+struct city_locations {
+    vector<int> route_of, position_of; // -1 for the depot
+    int total_routes = 0;
+    void locate(const vector< vector<int> >& routes, int dimension);
+    // after a move between route1 and route2 (everything again if it erased a route)
+    void relocate(const vector< vector<int> >& routes, int route1, int route2);
+    void locate_route(const vector< vector<int> >& routes, int route);
+};
+
+// Best improvement operators: apply the best improving move and return whether one was found.
+// The granular versions only look at moves involving the k nearest neighbors of each customer;
+// locations must describe updated_routes, and still do on return.
+bool apply_best_exchange(vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, const instance& data_inst);
+bool apply_best_delete_and_insert(vector< vector<int> >& updated_routes, vector<int>& updated_routes_capacities, const instance& data_inst);
+bool apply_best_exchange_granular(vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, const instance& data_inst, int k, city_locations& locations);
+bool apply_best_delete_and_insert_granular(vector< vector<int> >& updated_routes, vector<int>& updated_routes_capacities, const instance& data_inst, int k, city_locations& locations);
+bool apply_best_two_opt(vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, const instance& data_inst);
+bool apply_best_or_opt(vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, const instance& data_inst);
+bool apply_best_two_opt_star(vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities, const instance& data_inst);
+
+// Heap entry of a move_cache: the best move of one pair of routes, valid while version matches
+struct cached_move {
+    int gain;
+    int route1, route2;
+    int version;
+};
+
+/*
+ * Static move descriptors for best improvement descents: the best exchange and the best
+ * delete_and_insert of every pair of routes, kept between iterations. A move changes only two
+ * routes, so only the pairs involving them are evaluated again (O(n * |changed routes|) instead
+ * of the O(n^2) rescan), and the best pair comes from a heap whose stale entries are skipped by
+ * version. Ties are broken in the scan order of apply_best_*, so a descent takes exactly the same
+ * moves as with full scans. Everything is rebuilt when the number of routes changes.
+ * Each type is scored lazily: a changed route waits in pending[type] until best(type) is asked,
+ * so a descent that keeps drawing exchanges never scores delete_and_insert pairs in between, and
+ * a pair of two changed routes is scored once.
+ * Pairs of routes too far apart to have an improving move (route_bounds.h) are not scanned; the
+ * summaries of the two routes of a committed move are computed again before their pairs. Pairs
+ * of short routes skip that test, which would cost more than their scan.
+ * With the gain kernel, the pairs are scored on one block of the whole solution kept by the cache,
+ * where only the routes of each move are laid out again.
+ */
+struct move_cache {
+    int total_routes = 0;
+    vector<move_proposal> best_moves[2]; // [EXCHANGE or DELETE_AND_INSERT][route1 * total_routes + route2]
+    vector<int> versions[2];
+    vector<cached_move> heaps[2];
+    vector<char> stale[2];           // stale[t][r]: the pairs of route r are not scored for type t yet
+    vector<int> pending[2];          // routes with stale[t][r] set
+    vector<route_summary> summaries; // summaries[r] describes routes[r]
+    bool blocked = false;            // gain kernel active at the last rebuild: pairs are scored on block
+    route_block block;               // every route laid out (gain_kernel.h)
+
+    // starts over on routes: every pair is pending for both types
+    void rebuild(const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst);
+    // the pairs of route must be scored again (its summary and block must be up to date)
+    void mark_changed(int route);
+    // scores again the pairs of the pending routes of type
+    void refresh(const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int type);
+    void evaluate_pair(const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int type, int route1, int route2);
+    // best move of type in routes (delta >= 0 when nothing improves)
+    move_proposal best(const vector< vector<int> >& routes, const vector<int>& route_capacities, const instance& data_inst, int type);
+    // applies the best improving move of type, if any, and updates the cache (and *hash, see solution_hash.h)
+    bool apply_best(vector< vector<int> >& routes, vector<int>& route_capacities, const instance& data_inst, int type, uint64_t* hash = nullptr);
+};
+
+// Average number of customers per route from which a move_cache beats the full rescans
+// ("./BENCHMARK cache": 0.9x on X-n101, 4 customers per route, 1.3x on X-n110, 8.5 per route)
+constexpr int MOVE_CACHE_MIN_ROUTE_LENGTH = 6;
+
+// Whether a best improvement descent from routes should keep a move_cache
+inline bool use_move_cache(const vector< vector<int> >& routes) {
+    int customers = 0;
+    for (const vector<int>& route : routes) customers += (int)route.size() - 1;
+    return customers >= MOVE_CACHE_MIN_ROUTE_LENGTH * (int)routes.size();
+}
+
+// Variation of solution_hash (solution_hash.h) caused by m, computed like its delta in O(1)
+uint64_t move_hash_delta(const vector< vector<int> >& routes, const move_proposal& m, const instance& data_inst);
+
+// Longest route a vehicle can serve: the depot plus the most customers whose demands fit in it
+int max_route_length(const instance& data_inst);
+// Gives every route the capacity of the longest feasible one, so the moves and the copies
+// between solutions of a local search never reallocate them
+void reserve_routes(vector< vector<int> >& routes, const instance& data_inst);
+
+// Seed of the independent random stream number `stream` derived from base_seed (splitmix64),
+// used to give each restart / thread its own reproducible generator
+inline unsigned derive_seed(unsigned base_seed, int stream) {
+    uint64_t z = base_seed + 0x9e3779b97f4a7c15ULL * (uint64_t)(stream + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (unsigned)(z ^ (z >> 31));
+}
 
 struct neighborhood_generator {
-    instance data_inst;
+    shared_ptr<const instance> data_inst; // shared by every solver working on the same instance
     int seed;
+    mt19937 rng; // every generator owns its random stream, so generators can run in parallel
+    int granular_neighbors = 0;
+    // load_prefix of the routes given to track_loads, kept up to date by apply_move, so that the
+    // 2-opt* proposals check capacities in O(1). Changing them by other means (the update_solution_*
+    // functions drop them) requires calling track_loads again.
+    const vector< vector<int> >* tracked_routes = nullptr;
+    vector< vector<int> > load_prefixes;
+    // customers of located_routes, kept up to date by the granular best improvement steps; any
+    // other change of those routes (every other update_solution_* step drops them) requires
+    // calling locate_cities again
+    const vector< vector<int> >* located_routes = nullptr;
+    city_locations locations;
     void update_solution(vector<vector<int> > &updated_routes, vector<int> &updated_route_capacities);
     void update_solution_custom( vector< vector<int> >& updated_routes, vector<int>& update_route_capacities, vector<int>& neighborhood_indicies );
     void update_solution_deterministic( vector< vector<int> >& updated_routes, vector<int>& update_route_capacities, int n_type);
     bool update_solution_best_improvement(vector< vector<int> >& updated_routes, vector<int> &updated_route_capacities);
+    bool update_solution_best_improvement(vector< vector<int> >& updated_routes, vector<int> &updated_route_capacities, const vector<int>& neighborhood_indices);
+    bool update_solution_best_improvement(vector< vector<int> >& updated_routes, vector<int> &updated_route_capacities, move_cache& cache, uint64_t* hash = nullptr);
+    move_proposal propose_move(const vector< vector<int> >& routes, const vector<int>& route_capacities);
+    move_proposal propose_move_custom(const vector< vector<int> >& routes, const vector<int>& route_capacities, const vector<int>& neighborhood_indices);
+    void apply_move(vector< vector<int> >& routes, vector<int>& route_capacities, const move_proposal& m);
+    void track_loads(const vector< vector<int> >& routes);
+    void forget_loads(const vector< vector<int> >& routes) { if (&routes == tracked_routes) tracked_routes = nullptr; }
+    void locate_cities(const vector< vector<int> >& routes);
+    void forget_cities(const vector< vector<int> >& routes) { if (&routes == located_routes) located_routes = nullptr; }
     //void update_solution_best_improvement_deterministic( vector< vector<int> >& updated_routes, vector<int>& updated_route_capacities);
     void set_seed(int s);
-    neighborhood_generator(instance inst);
+    void set_granular(int k);
+    neighborhood_generator(shared_ptr<const instance> inst);
     neighborhood_generator();
 };
 
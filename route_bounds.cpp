@@ -0,0 +1,94 @@
+#include "route_bounds.h"
+
+constexpr double TWO_PI = 2 * M_PI;
+
+route_summary summarize_route( const vector<int>& route, const instance& data_inst )
+{
+    route_summary s;
+    int size = (int) route.size();
+    s.customers = size - 1;
+    if( s.customers <= 0 ) return s;
+    const distance_matrix& d = data_inst.distances;
+    int depot = data_inst.depot_index;
+    const pair<int, int>& center = data_inst.points[depot];
+    s.min_x = s.min_y = 0x3f3f3f3f;
+    s.max_x = s.max_y = -0x3f3f3f3f;
+    s.min_euclidean_radius = 1e18;
+    s.min_radius = s.min_inner_radius = INNER_NONE;
+    s.max_end_radius = s.max_inner_edge = s.max_removal = 0;
+    thread_local vector<double> angles;
+    angles.clear();
+    bool on_depot = false;
+    for(int i = 1; i < size; ++i)
+    {
+        int c = route[i];
+        int prev = route[i - 1], next = ( i + 1 < size ? route[i + 1] : depot );
+        const pair<int, int>& p = data_inst.points[c];
+        s.min_x = min(s.min_x, p.first);
+        s.max_x = max(s.max_x, p.first);
+        s.min_y = min(s.min_y, p.second);
+        s.max_y = max(s.max_y, p.second);
+        double dx = p.first - center.first, dy = p.second - center.second;
+        s.min_euclidean_radius = min(s.min_euclidean_radius, sqrt(dx * dx + dy * dy));
+        if( dx == 0 && dy == 0 ) on_depot = true;
+        else angles.push_back(atan2(dy, dx));
+
+        int radius = d.dist(depot, c);
+        s.min_radius = min(s.min_radius, radius);
+        if( i == 1 || i == size - 1 ) s.max_end_radius = max(s.max_end_radius, radius);
+        else s.min_inner_radius = min(s.min_inner_radius, radius);
+        if( i > 1 ) s.max_inner_edge = max(s.max_inner_edge, d.dist(prev, c));
+        s.max_removal = max(s.max_removal, d.dist(prev, c) + d.dist(c, next) - d.dist(prev, next));
+    }
+
+    // the sector is the circle without the largest gap between consecutive angles
+    s.sector_start = 0;
+    s.sector_width = TWO_PI;
+    if( on_depot || angles.empty() ) return s; // a customer on the depot has every direction
+    sort(angles.begin(), angles.end());
+    int total = (int) angles.size();
+    double largest_gap = angles[0] + TWO_PI - angles[total - 1];
+    s.sector_start = angles[0];
+    for(int k = 1; k < total; ++k)
+    {
+        if( angles[k] - angles[k - 1] > largest_gap )
+        {
+            largest_gap = angles[k] - angles[k - 1];
+            s.sector_start = angles[k];
+        }
+    }
+    s.sector_width = TWO_PI - largest_gap;
+    return s;
+}
+
+void summarize_routes( const vector< vector<int> >& routes, const instance& data_inst, vector<route_summary>& summaries )
+{
+    summaries.resize(routes.size());
+    for(int r = 0; r < (int) routes.size(); ++r) summaries[r] = summarize_route(routes[r], data_inst);
+}
+
+// Angle between the sectors of a and b, 0 when they overlap
+static double sector_gap( const route_summary& a, const route_summary& b )
+{
+    if( a.sector_width >= TWO_PI || b.sector_width >= TWO_PI ) return 0;
+    double b_from_a = fmod(b.sector_start - a.sector_start + 2 * TWO_PI, TWO_PI);
+    double a_from_b = fmod(a.sector_start - b.sector_start + 2 * TWO_PI, TWO_PI);
+    if( b_from_a <= a.sector_width || a_from_b <= b.sector_width ) return 0;
+    return min(b_from_a - a.sector_width, a_from_b - b.sector_width);
+}
+
+double customer_gap( const route_summary& a, const route_summary& b )
+{
+    long long dx = max(0, max(a.min_x - b.max_x, b.min_x - a.max_x));
+    long long dy = max(0, max(a.min_y - b.max_y, b.min_y - a.max_y));
+    double box = sqrt( (double) (dx * dx + dy * dy) );
+    // p and q at an angle t from the depot: |p - q| >= max(|p|, |q|) * sin(min(t, 90 degrees))
+    double angle = min(sector_gap(a, b), M_PI / 2);
+    double polar = max(a.min_euclidean_radius, b.min_euclidean_radius) * sin(angle);
+    return max(box, polar);
+}
+
+static bool pruning = true;
+
+void set_route_pruning( bool enabled ) { pruning = enabled; }
+bool route_pruning_enabled() { return pruning; }
@@ -0,0 +1,84 @@
+#ifndef ROUTE_BOUNDS_H
+#define ROUTE_BOUNDS_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "data_loader.h"
+
+using namespace std;
+
+/*
+ * Spatial summary of a route, enough to bound from below the delta of every exchange and every
+ * delete_and_insert between two routes without looking at their customers.
+ * The distances are rounded up euclidean (EUC_2D), so d(p, q) is at least the euclidean distance
+ * between p and q, and the triangle inequality holds. Every route goes through the depot, so the
+ * customers closest to it are near each other whatever the direction of the routes: the depot is
+ * left out of the bounding box, the polar sector (angles seen from the depot) bounds the distance
+ * between two routes by radius * sin(angle between them), and the edges that touch the depot are
+ * bounded through the depot distances of the first / last customers.
+ * A pair whose bound is above -1 (deltas are integers) has no improving move and is skipped by
+ * the scans, which therefore still choose exactly the same moves.
+ */
+struct route_summary
+{
+    int customers = 0;
+    int min_x, max_x, min_y, max_y;      // bounding box of the customers
+    double sector_start, sector_width;   // smallest arc (radians, counterclockwise) holding the customers
+    double min_euclidean_radius;         // distance from the depot to the closest customer, not rounded
+    int min_radius;                      // d(depot, c) over the customers
+    int max_end_radius;                  // d(depot, c) over the first and the last customer
+    int min_inner_radius;                // d(depot, c) over the others (INNER_NONE if there are none)
+    int max_inner_edge;                  // longest edge between two customers, 0 with a single customer
+    int max_removal;                     // largest d(prev, c) + d(c, next) - d(prev, next)
+};
+
+constexpr int INNER_NONE = 0x3f3f3f3f;
+
+// O(|route| log |route|), called again for the two routes a committed move has changed
+route_summary summarize_route( const vector<int>& route, const instance& data_inst );
+void summarize_routes( const vector< vector<int> >& routes, const instance& data_inst, vector<route_summary>& summaries );
+
+// Lower bound of the distance between a customer of a and a customer of b
+double customer_gap( const route_summary& a, const route_summary& b );
+
+// Deltas are integers: a lower bound above this one rules out an improving move (the margin
+// absorbs the rounding of the trigonometry)
+constexpr double NO_IMPROVEMENT_BOUND = -0.99;
+
+/*
+ * Exchange of F (route a) and S (route b), routes with 2 customers or more. Each of the 4 edges
+ * next to F and S changes by d(p, S) - d(p, F) (or the other way around): at least gap - longest
+ * inner edge when p is a customer. When F and S are both next to the depot the two depot terms
+ * cancel; when only F is, d(depot, S) - d(depot, F) >= b.min_inner_radius - a.max_end_radius.
+ */
+inline bool exchange_may_improve( const route_summary& a, const route_summary& b )
+{
+    if( a.customers < 2 || b.customers < 2 ) return true;
+    double gap = customer_gap(a, b);
+    double inner_a = gap - a.max_inner_edge, inner_b = gap - b.max_inner_edge;
+    double bound = inner_a + inner_b; // F and S next to the depot
+    if( b.min_inner_radius != INNER_NONE ) bound = min( bound, (double) (b.min_inner_radius - a.max_end_radius) + inner_a + 2 * inner_b );
+    if( a.min_inner_radius != INNER_NONE ) bound = min( bound, (double) (a.min_inner_radius - b.max_end_radius) + 2 * inner_a + inner_b );
+    if( a.min_inner_radius != INNER_NONE && b.min_inner_radius != INNER_NONE ) bound = min( bound, 2 * inner_a + 2 * inner_b );
+    return bound <= NO_IMPROVEMENT_BOUND;
+}
+
+/*
+ * Move of a customer c of from into to: inserting it between two customers costs at least
+ * 2 * gap - the longest inner edge, next to the depot d(depot, c) + d(c, w) - d(depot, w) with w
+ * the first or last customer, and never less than 0. Removing it saves at most from.max_removal.
+ */
+inline bool relocation_may_improve( const route_summary& from, const route_summary& to )
+{
+    if( from.customers == 0 || to.customers == 0 ) return true;
+    double gap = customer_gap(from, to);
+    double insertion = min( gap + from.min_radius - to.max_end_radius, 2 * gap - to.max_inner_edge );
+    return max( 0.0, insertion ) - from.max_removal <= NO_IMPROVEMENT_BOUND;
+}
+
+// Pruning of route pairs in the scans (on by default, off to measure it)
+void set_route_pruning( bool enabled );
+bool route_pruning_enabled();
+
+#endif
@@ -3,12 +3,62 @@
 #include <algorithm>
 #include <cstdio>
 #include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "data_loader.h"
 #include "neighborhood_generator.h"
 #include "time_lib.h"
+#include "batch_runner.h"
+#include "giant_tour.h"
+#include "alloc_counter.h"
+#include "acceptance.h"
+#include "solution_hash.h"
+#include "construction.h"
+#include "instrumentation.h"
+
+// Reusable barrier for a fixed number of threads (std::barrier is C++20)
+struct round_barrier {
+    mutex m;
+    condition_variable cv;
+    int participants, waiting = 0, generation = 0;
+    
+    round_barrier(int n) : participants(n) {}
+    
+    void wait() {
+        unique_lock<mutex> lock(m);
+        int my_generation = generation;
+        if (++waiting == participants) {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+        }
+        else cv.wait(lock, [&] { return generation != my_generation; });
+    }
+};
+
+// One Markov chain of the parallel tempering: its own state, generator and fixed temperature
+struct tempering_chain {
+    neighborhood_generator n_generator;
+    vector<vector<int>> routes;
+    vector<int> routes_capacities;
+    int cost;
+    float temperature;
+    
+    vector<vector<int>> best_routes; // stale while best_is_current
+    int best_cost;
+    bool best_is_current;
+    
+    // copies the current solution into best_routes before it is left
+    void save_best() {
+        if (best_is_current) best_routes = routes;
+        best_is_current = false;
+    }
+    const vector<vector<int>>& best_solution() const { return (best_is_current ? routes : best_routes); }
+};
 
 struct simulated_annealing {
-    instance data_inst;
+    shared_ptr<const instance> data_inst; // shared, never copied
     neighborhood_generator n_generator;
     vector<vector<int>> cur_routes; // vector containing which node belongs to which routes (the end of the route is delimited by zero)
     vector<int> cur_routes_capacities; // contains capacity for every route
@@ -16,26 +66,39 @@ struct simulated_annealing {
     
     vector<vector<int>> best_routes;
     int best_route_cost;
+    bool split_initial_tour = false; // smart_greedy cuts the radial giant tour with the optimal Split
+    cost_evaluator evaluator; // same costs as GRASP, unchanged routes are not summed again
+    long long loop_allocations = 0; // heap allocations in the last search loop (see alloc_counter.h)
+    sweep_constructor sweep; // polar order of the customers, computed once
+    vector<int> tour_buffer;
+    bool savings_initial = false; // initial solution by Clarke-Wright instead of smart_greedy
+    savings_constructor savings; // savings list, computed by the first construction
+    int tabu_tenure = 0; // > 0: moves back to one of the last tabu_tenure states are rejected (solution_hash.h)
+    recent_states tabu;
+    long long tabu_rejections = 0; // accepted moves dropped by the tabu list in the last annealing_CVRP run
+    INSTRUMENT( search_trajectory trajectory; ) // temperature and costs of the last annealing_CVRP run
+    INSTRUMENT( search_counters chain_counters; ) // counters of the chains on other threads in the last parallel_tempering
     
-    simulated_annealing(instance ins) {
+    simulated_annealing(shared_ptr<const instance> ins) {
         data_inst = ins;
         n_generator = neighborhood_generator(ins);
-        test_constants();
+        evaluator = cost_evaluator(ins.get());
+        sweep = sweep_constructor(ins.get());
     }
     
     /**
      * Auxiliary functions
      */
-    void print_solution(vector<vector<int>> routes) {
+    void print_solution(const vector<vector<int>>& routes) {
         int route_capacity = 0;
         cout << "Route" << endl;
         for (int r = 0; r < (int) routes.size(); r++) {
-            vector<int> route = routes[r];
+            const vector<int>& route = routes[r];
             for (int i = 0; i < (int) route.size(); i++ ) {
                 int visited_city = route[i];
-                cout << visited_city << " " << data_inst.points[visited_city].first << " " << data_inst.points[visited_city].second << " " << data_inst.demands[visited_city] << endl;
-                route_capacity += data_inst.demands[visited_city];
-                if (visited_city == data_inst.depot_index) {
+                cout << visited_city << " " << data_inst->points[visited_city].first << " " << data_inst->points[visited_city].second << " " << data_inst->demands[visited_city] << endl;
+                route_capacity += data_inst->demands[visited_city];
+                if (visited_city == data_inst->depot_index) {
                     cout << "Route capacity: " << route_capacity << endl << endl;
                     route_capacity = 0;
                     cout << "Route" << endl;
@@ -44,7 +107,7 @@ struct simulated_annealing {
         }
     }
     
-    void print_vec(vector<int > v) {
+    void print_vec(const vector<int>& v) {
         for (int i = 0; i < (int) v.size(); i++) {
             cout << v[i] << ", ";
         }
@@ -52,31 +115,20 @@ struct simulated_annealing {
     }
   
     int route_capacity(vector<vector<int>>& routes, int route_idx) {
-        vector<int> route = routes[route_idx];
+        const vector<int>& route = routes[route_idx];
         int capacity = 0;
         for (int i = 0; i < (int) route.size(); i++) {
-            capacity += data_inst.demands[route[i]];
+            capacity += data_inst->demands[route[i]];
         }
         return capacity;
     }
     
-    int route_cost(vector<int> route) {
-        int cost = 0;
-        for (int i = 0; i < (int) route.size() - 1; i++) {
-            int dist = data_inst.adjacency_matrix[route[i]][route[i+1]];
-            cost += dist;
-        }
-        int dist_origin = data_inst.adjacency_matrix[route[route.size() - 1]][data_inst.depot_index];
-        cost += dist_origin;
-        return cost;
+    int route_cost(const vector<int>& route) {
+        return evaluator.route_cost(route);
     }
     
-    int solution_cost(vector<vector<int>> routes) {
-        int cost = 0;
-        for (int r = 0; r < (int) routes.size(); r++) {
-            cost += route_cost(routes[r]);
-        }
-        return cost;
+    int solution_cost(const vector<vector<int>>& routes) {
+        return evaluator.solution_cost(routes);
     }
     
     /**
@@ -87,19 +139,19 @@ struct simulated_annealing {
     void initial_solution_greedy() {
         cur_routes.clear();
         cur_routes_capacities.clear();
-        vector<int> city_visited_status(data_inst.dimension); // by default, initializes to 0
+        vector<int> city_visited_status(data_inst->dimension); // by default, initializes to 0
         int visited_cities = 1;
-        city_visited_status[data_inst.depot_index] = 1;
-        while (visited_cities < data_inst.dimension) {
+        city_visited_status[data_inst->depot_index] = 1;
+        while (visited_cities < data_inst->dimension) {
             int current_capacity = 0;
             vector<int> route;
-            route.emplace_back(data_inst.depot_index);
+            route.emplace_back(data_inst->depot_index);
             
-            for (int v = 0; v < data_inst.dimension; v++) {
+            for (int v = 0; v < data_inst->dimension; v++) {
                 if (city_visited_status[v] == 0 &&
-                    current_capacity + data_inst.demands[v] < data_inst.uniform_vehicle_capacity) {
+                    current_capacity + data_inst->demands[v] < data_inst->uniform_vehicle_capacity) {
                     route.emplace_back(v);
-                    current_capacity += data_inst.demands[v];
+                    current_capacity += data_inst->demands[v];
                     city_visited_status[v] = 1;
                     visited_cities++;
                 }
@@ -109,68 +161,46 @@ struct simulated_annealing {
         }
     }
     
+    // Customers sorted by the angle they make with the depot: the giant tour smart_greedy cuts into routes
+    // (the polar order is computed once, by the sweep_constructor)
+    const vector<int>& smart_greedy_giant_tour() {
+        sweep.rotated_tour(0, tour_buffer);
+        return tour_buffer;
+    }
+    
+    // Fills routes greedily along the giant tour, or with the optimal Split when split_initial_tour is set
     void smart_greedy() {
-        cur_routes.clear();
-        cur_routes_capacities.clear();
-        
-        vector< vector<int> > routes(1, vector<int>(1, data_inst.depot_index));
-        vector< int > route_demand(1, 0);
-        vector< tuple<int, int, int> > points;
-        pair<int, int> center = data_inst.points[data_inst.depot_index];
-        for(int p = 0; p < data_inst.dimension; ++p)
-        {
-            if( p == data_inst.depot_index ) continue;
-            points.emplace_back( data_inst.points[p].first, data_inst.points[p].second, p );
-        }
-        // Radial sort
-        sort( points.begin(), points.end(), [&] (tuple<int, int, int>& a, tuple<int, int, int>& b)
-             {
-                 pair<int, int> pa = make_pair(get<0>(a) - center.first, get<1>(a) - center.second);
-                 pair<int, int> pb = make_pair(get<0>(b) - center.first, get<1>(b) - center.second);
-                 int cross_product = pa.first * pb.second - pa.second * pb.first;
-                 if( cross_product != 0 ) return (cross_product > 0);
-                 pa = make_pair(pa.first * pa.first, pa.second * pa.second );
-                 pb = make_pair(pb.first * pb.first, pb.second * pb.second );
-                 int len_a = pa.first + pa.second;
-                 int len_b = pb.first + pb.second;
-                 
-                 return len_a < len_b;
-             });
-        
-        int current_route = 0;
-        for(const auto& P : points)
-        {
-            int point_index = get<2>(P);
-            if( data_inst.demands[point_index] + route_demand[current_route] <= data_inst.uniform_vehicle_capacity )
-            {
-                route_demand[current_route] += data_inst.demands[point_index];
-                routes[current_route].push_back( point_index );
-            }
-            else
-            {
-                current_route++;
-                route_demand.push_back(0);
-                route_demand[current_route] += data_inst.demands[point_index];
-                routes.push_back( vector<int>(1, data_inst.depot_index) );
-                routes.back().push_back( point_index );
-                
-            }
+        smart_greedy_giant_tour();
+        if (split_initial_tour) cur_route_cost = split_giant_tour(tour_buffer, *data_inst, cur_routes, cur_routes_capacities);
+        else cur_route_cost = sweep.sweep_routes(tour_buffer, cur_routes, cur_routes_capacities);
+    }
+    
+    // smart_greedy, or the Clarke-Wright savings (construction.h) when savings_initial is set
+    void initial_solution() {
+        INSTRUMENT( phase_timer timing(PHASE_CONSTRUCTION); )
+        if (!savings_initial) {
+            smart_greedy();
+            return;
         }
-        
-        cur_routes = routes;
-        cur_routes_capacities = route_demand;
-        cur_route_cost = solution_cost(cur_routes);
+        if (savings.data_inst == nullptr) savings = savings_constructor(data_inst.get());
+        cur_route_cost = savings.build(cur_routes, cur_routes_capacities);
     }
     
     /*
     * Simulated Annealing
     */
     int should_update(float cost_diff, float temp) {
-        float prob = exp(-cost_diff / temp) * 100;
-        return (rand() % 100 < prob);
+        return metropolis_accept(cost_diff, temp, n_generator.rng);
     }
     
-    vector<vector<int>> annealing_CVRP(float initial_temperature, float temp_factor) {
+    // also stops when limits is reached (wall clock deadline or target cost)
+    // The loop does not allocate: moves are applied in place on routes reserved to their longest
+    // feasible length, and best_routes is only copied (into its own reserved buffers) when the
+    // search accepts a worsening move while standing on the best solution
+    // With tabu_tenure > 0 the hash of the current solution follows the applied moves and an accepted
+    // move that leads back to one of the last tabu_tenure states is rejected, which breaks the short
+    // worsen / improve cycles of the low temperatures at the cost of an O(1) hash delta per acceptance
+    vector<vector<int>> annealing_CVRP(float initial_temperature, float temp_factor, search_limits limits = search_limits()) {
         const float cutoff_time = 5; // iterations for a given temperature until the next update
         const float max_time_improvement = 10000;
         
@@ -178,56 +208,227 @@ struct simulated_annealing {
         int time_since_improvement = 0;
         float temperature = initial_temperature;
         
-        smart_greedy();
+        initial_solution();
         cur_route_cost = solution_cost(cur_routes);
+        reserve_routes(cur_routes, *data_inst);
+        INSTRUMENT( phase_timer timing(PHASE_LOCAL_SEARCH); trajectory.clear(); long long iteration = 0; )
         
         best_routes = cur_routes;
+        reserve_routes(best_routes, *data_inst);
         best_route_cost = solution_cost(best_routes);
+        bool best_is_current = true; // best_routes is stale while the current solution is the best one
+        tabu.reset(tabu_tenure);
+        tabu_rejections = 0;
+        uint64_t cur_hash = (tabu_tenure > 0 ? solution_hash(cur_routes, data_inst->depot_index) : 0);
+        tabu.push(cur_hash);
         
-        while (time_since_improvement < max_time_improvement) {
+        long long allocations_before = allocation_count();
+        while (time_since_improvement < max_time_improvement && !limits.should_stop(best_route_cost)) {
             time_since_improvement++;
-            vector<vector<int>> updated_routes(cur_routes);
-            vector<int> updated_route_capacities(cur_routes_capacities);
-            n_generator.update_solution(updated_routes, updated_route_capacities);
-            float new_cost = solution_cost(updated_routes);
-            float cost_diff = new_cost - cur_route_cost;
-            if (cost_diff < 0) { // update improved solution
+            // the move is only evaluated; routes are touched only if it is accepted
+            move_proposal proposal = n_generator.propose_move(cur_routes, cur_routes_capacities);
+            float new_cost = cur_route_cost + proposal.delta;
+            float cost_diff = proposal.delta;
+            bool accepted = (cost_diff < 0 || (cost_diff != 0 && should_update(cost_diff, temperature)));
+            uint64_t new_hash = 0;
+            if (accepted && tabu_tenure > 0) {
+                new_hash = cur_hash + move_hash_delta(cur_routes, proposal, *data_inst);
+                if (tabu.contains(new_hash)) {
+                    accepted = false;
+                    tabu_rejections++;
+                }
+            }
+            if (accepted && cost_diff < 0) { // update improved solution
                 time_since_improvement = 0;
-                cur_routes = updated_routes;
-                cur_routes_capacities = updated_route_capacities;
+                n_generator.apply_move(cur_routes, cur_routes_capacities, proposal);
                 cur_route_cost = new_cost;
                 if (new_cost < best_route_cost) {
-                    best_routes.assign(updated_routes.begin(), updated_routes.end());
+                    best_is_current = true;
                     best_route_cost = new_cost;
                 }
             }
-            else if (cost_diff != 0 && should_update(cost_diff, temperature)) {
-                cur_routes = updated_routes;
-                cur_routes_capacities = updated_route_capacities;
+            else if (accepted) {
+                if (best_is_current) {
+                    best_routes = cur_routes;
+                    best_is_current = false;
+                }
+                n_generator.apply_move(cur_routes, cur_routes_capacities, proposal);
                 cur_route_cost = new_cost;
             }
+            if (accepted && tabu_tenure > 0) {
+                cur_hash = new_hash;
+                tabu.push(cur_hash);
+            }
+            INSTRUMENT( trajectory.record(iteration++, temperature, cur_route_cost, best_route_cost); )
             temp_time++;
             if (temp_time == cutoff_time) {
                 temp_time = 0;
                 temperature *= temp_factor;
             }
         }
+        loop_allocations = allocation_count() - allocations_before;
+        if (best_is_current) best_routes = cur_routes;
 //        print_solution(best_routes);
         return best_routes;
     }
     
-    void test_constants() {
+    /*
+     * Parallel tempering
+     * One chain per temperature, each on its own thread with its own generator. Chains run
+     * steps_per_swap iterations at their fixed temperature, then neighboring temperatures
+     * try to exchange states with probability min(1, exp((E_i - E_j) * (1/T_i - 1/T_j))),
+     * alternating even and odd pairs between rounds. Stops after max_stall_rounds rounds
+     * without improving the best solution, or when limits is reached (checked between rounds).
+     */
+    vector<vector<int>> parallel_tempering(const vector<float>& temperatures, int steps_per_swap, int max_stall_rounds, unsigned seed, search_limits limits = search_limits()) {
+        int total_chains = (int) temperatures.size();
+        initial_solution();
+        
+        vector<tempering_chain> chains(total_chains);
+        for (int c = 0; c < total_chains; c++) {
+            chains[c].n_generator = neighborhood_generator(data_inst);
+            chains[c].n_generator.set_seed(derive_seed(seed, c));
+            chains[c].routes = cur_routes;
+            chains[c].routes_capacities = cur_routes_capacities;
+            chains[c].cost = cur_route_cost;
+            chains[c].temperature = temperatures[c];
+            chains[c].best_routes = cur_routes;
+            chains[c].best_cost = cur_route_cost;
+            chains[c].best_is_current = true;
+            reserve_routes(chains[c].routes, *data_inst);
+            reserve_routes(chains[c].best_routes, *data_inst);
+        }
+        best_routes = cur_routes;
+        reserve_routes(best_routes, *data_inst);
+        best_route_cost = cur_route_cost;
+        mt19937 swap_rng(derive_seed(seed, total_chains));
+        
+        auto run_round = [&] (tempering_chain& chain) {
+            for (int step = 0; step < steps_per_swap; step++) {
+                move_proposal proposal = chain.n_generator.propose_move(chain.routes, chain.routes_capacities);
+                if (proposal.delta < 0 || (proposal.delta != 0 && metropolis_accept(proposal.delta, chain.temperature, chain.n_generator.rng))) {
+                    if (proposal.delta > 0) chain.save_best();
+                    chain.n_generator.apply_move(chain.routes, chain.routes_capacities, proposal);
+                    chain.cost += proposal.delta;
+                    if (chain.cost < chain.best_cost) {
+                        chain.best_cost = chain.cost;
+                        chain.best_is_current = true;
+                    }
+                }
+            }
+        };
+        
+        round_barrier barrier(total_chains);
+        bool finished = false;
+        int stall_rounds = 0, round = 0;
+        
+        // chain 0 runs on the calling thread and coordinates the swaps between rounds
+        // the phase is timed on this thread only (wall time); the other chains just count their moves
+        INSTRUMENT( phase_timer timing(PHASE_LOCAL_SEARCH); chain_counters = search_counters(); mutex counters_mutex; )
+        auto worker = [&] (int c) {
+            INSTRUMENT( take_thread_counters(); )
+            while (true) {
+                barrier.wait(); // round starts
+                if (finished) {
+                    INSTRUMENT( lock_guard<mutex> lock(counters_mutex); chain_counters.add(take_thread_counters()); )
+                    return;
+                }
+                run_round(chains[c]);
+                barrier.wait(); // round ends
+            }
+        };
+        vector<thread> pool;
+        for (int c = 1; c < total_chains; c++) pool.emplace_back(worker, c);
+        long long allocations_before = allocation_count();
+        
+        while (!finished) {
+            barrier.wait();
+            run_round(chains[0]);
+            barrier.wait();
+            
+            bool improved = false;
+            for (const tempering_chain& chain : chains) {
+                if (chain.best_cost < best_route_cost) {
+                    best_route_cost = chain.best_cost;
+                    best_routes = chain.best_solution();
+                    improved = true;
+                }
+            }
+            stall_rounds = (improved ? 0 : stall_rounds + 1);
+            
+            for (int c = round % 2; c + 1 < total_chains; c += 2) {
+                tempering_chain& a = chains[c];
+                tempering_chain& b = chains[c + 1];
+                double exponent = (double) (a.cost - b.cost) * (1.0 / a.temperature - 1.0 / b.temperature);
+                if (exponent >= 0 || generate_canonical<double, 32>(swap_rng) < exp(exponent)) {
+                    a.save_best();
+                    b.save_best();
+                    swap(a.routes, b.routes);
+                    swap(a.routes_capacities, b.routes_capacities);
+                    swap(a.cost, b.cost);
+                }
+            }
+            round++;
+            if (stall_rounds >= max_stall_rounds || limits.time_limit.expired() || limits.reached_target(best_route_cost)) {
+                finished = true;
+                barrier.wait(); // releases the workers so they see finished
+            }
+        }
+        loop_allocations = allocation_count() - allocations_before;
+        for (thread& t : pool) t.join();
+        return best_routes;
+    }
+    
+    // Geometric ladder of total_chains temperatures between t_min and t_max
+    static vector<float> temperature_ladder(int total_chains, float t_min, float t_max) {
+        vector<float> temperatures(total_chains, t_min);
+        for (int c = 1; c < total_chains; c++) temperatures[c] = t_min * pow(t_max / t_min, (float) c / (total_chains - 1));
+        return temperatures;
+    }
+    
+    int instance_bks() {
+        const string& name = data_inst->instance_name;
+        if( name == "X-n101-k25" ) return 27591;
+        else if( name == "X-n110-k13") return 14971;
+        else if( name == "X-n115-k10") return 12747;
+        return 19565;
+    }
+    
+    // Limits for one run: time_limit_ms <= 0 means no deadline, target_gap < 0 means no target
+    search_limits run_limits(long double time_limit_ms, double target_gap) {
+        return search_limits(time_limit_ms, (target_gap >= 0 ? search_limits::target_from_gap(instance_bks(), target_gap) : -1), 256);
+    }
+    
+    void test_parallel_tempering(int total_chains, long double time_limit_ms = 0, double target_gap = -1) {
+        const float t_min = 1, t_max = 200;
+        const int steps_per_swap = 200, max_stall_rounds = 50;
+        int instance_BKS = instance_bks();
+        INSTRUMENT( take_thread_counters(); )
+        wall_timer timer;
+        parallel_tempering(temperature_ladder(total_chains, t_min, t_max), steps_per_swap, max_stall_rounds, 13, run_limits(time_limit_ms, target_gap));
+        long double duration = timer.elapsed_ms();
+        INSTRUMENT(
+            search_counters totals = take_thread_counters();
+            totals.add(chain_counters);
+            write_run_counters("traces/sa_" + data_inst->instance_name + "_parallel_tempering.csv", totals, duration);
+        )
+        cout << data_inst->instance_name << ": " << best_route_cost << " em " << duration << " ms" << endl;
+        if (allocations_counted()) cout << "alocacoes durante as rodadas: " << loop_allocations << endl;
+        
+        ofstream out("simulated_annealing_results/" + data_inst->instance_name + "_parallel_tempering.csv");
+        out << "Cadeias,Temperatura minima,Temperatura maxima,Tempo (ms),Solucao,BKS,Approximation Ratio" << endl;
+        out << total_chains << "," << t_min << "," << t_max << "," << duration << "," << best_route_cost << "," << instance_BKS << "," << 1.0 * best_route_cost / instance_BKS << endl;
+        out.close();
+    }
+    
+    void test_constants(long double time_limit_ms = 0, double target_gap = -1) {
         vector<int> initial_temperatures = {10000, 9000, 8000, 7000, 6000, 5000, 4000, 3000, 2000, 1000, 500};
         vector<float> temp_factors = {0.85, 0.9, 0.95};
         int best_params_cost = 10e5;
         //int best_temp; float best_factor;
         map<pair<int, float>, pair<int, long double> > param_costs;
-        string csv_name = data_inst.instance_name;
-        int instance_BKS = 0;
-        if( csv_name == "X-n101-k25" ) instance_BKS = 27591;
-        else if( csv_name == "X-n110-k13") instance_BKS = 14971;
-        else if( csv_name == "X-n115-k10") instance_BKS = 12747;
-        else instance_BKS = 19565;
+        string csv_name = data_inst->instance_name;
+        int instance_BKS = instance_bks();
         cout << "BKS = " << instance_BKS << endl;
         csv_name += ".csv"; 
         csv_name = "simulated_annealing_results/" + csv_name; 
@@ -235,10 +436,16 @@ struct simulated_annealing {
         for (int t = 0; t < (int) initial_temperatures.size(); t++) {
             for (int f = 0; f < (int) temp_factors.size(); f++) {
                 cout << "rodando t = " << t << " f = " << f << endl;
-                clock_t start = get_time();
-                annealing_CVRP(initial_temperatures[t], temp_factors[f]);
-                clock_t end = get_time();
-                long double duration = time_in_ms(start, end); 
+                INSTRUMENT( take_thread_counters(); )
+                wall_timer timer;
+                annealing_CVRP(initial_temperatures[t], temp_factors[f], run_limits(time_limit_ms, target_gap));
+                long double duration = time_in_ms(timer);
+                INSTRUMENT(
+                    string trace_name = "traces/sa_" + data_inst->instance_name + "_" + to_string(initial_temperatures[t]) + "_" + to_string((int) round(temp_factors[f] * 100));
+                    write_run_counters(trace_name + ".csv", take_thread_counters(), duration);
+                    trajectory.write_csv(trace_name + "_trajectory.csv");
+                )
+                if (allocations_counted()) cout << "alocacoes no laco: " << loop_allocations << endl;
                 param_costs[make_pair(initial_temperatures[t], temp_factors[f])] = make_pair(best_route_cost, duration);
                 if (best_route_cost < best_params_cost) {
                     best_params_cost = best_route_cost;
@@ -255,11 +462,11 @@ struct simulated_annealing {
         out.close();
     }
     
-    void check_routes_data(vector<vector<int>> routes, vector<int> route_capacities) {
+    void check_routes_data(const vector<vector<int>>& routes, const vector<int>& route_capacities) {
         for (int r = 0; r < (int) routes.size(); r++) {
             int capacity = 0;
             for (int i = 0; i < (int) routes[r].size(); i++) {
-                capacity += data_inst.demands[routes[r][i]];
+                capacity += data_inst->demands[routes[r][i]];
             }
             if (route_capacities[r] != capacity) {
                 printf("route idx: %d, expected: %d, actual: %d\n", r, capacity, route_capacities[r]);
@@ -268,11 +475,106 @@ struct simulated_annealing {
     }
 };
 
-int main()
+/*
+ * Runs the experiment grid described in config_path (see batch_runner.h). Every
+ * (instance, temperature, factor) cell is an independent job with its own solver and seed;
+ * at most config.jobs run at once, each limited to config.time_budget_ms.
+ * Writes the same CSV columns as test_constants.
+ */
+void run_batch(const string& config_path) {
+    batch_config config = read_batch_config(config_path);
+    string output_dir = (config.output_dir.empty() ? "simulated_annealing_results/" : config.output_dir);
+    
+    struct cell { int instance_idx; int temperature; float factor; long double duration; int cost; };
+    vector<cell> cells;
+    for (int i = 0; i < (int) config.instances.size(); i++)
+        for (int t : config.temperatures)
+            for (float f : config.factors) cells.push_back(cell{i, t, f, 0, 0});
+    
+    vector<function<void()>> jobs;
+    for (int j = 0; j < (int) cells.size(); j++) {
+        jobs.push_back([&config, &cells, j] () {
+            cell& c = cells[j];
+            simulated_annealing annealing(load_shared_instance(config.instances[c.instance_idx]));
+            annealing.n_generator.set_seed(derive_seed(13, j));
+            int target = (config.target_gap >= 0 ? search_limits::target_from_gap(config.bks[c.instance_idx], config.target_gap) : -1);
+            INSTRUMENT( take_thread_counters(); )
+            wall_timer timer;
+            annealing.annealing_CVRP(c.temperature, c.factor, search_limits(config.time_budget_ms, target, 256));
+            c.duration = timer.elapsed_ms();
+            c.cost = annealing.best_route_cost;
+            INSTRUMENT(
+                string trace_name = "traces/sa_" + instance_basename(config.instances[c.instance_idx]) + "_" + to_string(c.temperature) + "_" + to_string((int) round(c.factor * 100));
+                write_run_counters(trace_name + ".csv", take_thread_counters(), c.duration);
+                annealing.trajectory.write_csv(trace_name + "_trajectory.csv");
+            )
+            printf("%s, t = %d f = %.2f: %d (%.1Lf ms)\n", config.instances[c.instance_idx].c_str(), c.temperature, c.factor, c.cost, c.duration);
+        });
+    }
+    run_jobs(jobs, config.jobs);
+    
+    // same row order as test_constants (sorted by temperature, then factor)
+    sort(cells.begin(), cells.end(), [] (const cell& a, const cell& b) {
+        return make_tuple(a.instance_idx, a.temperature, a.factor) < make_tuple(b.instance_idx, b.temperature, b.factor);
+    });
+    for (int i = 0; i < (int) config.instances.size(); i++) {
+        ofstream out(output_dir + instance_basename(config.instances[i]) + ".csv");
+        out << "Temperatura inicial,Fator de temperatura,Tempo (ms),Solucao,BKS,Approximation Ratio" << endl;
+        for (const cell& c : cells) {
+            if (c.instance_idx != i) continue;
+            out << c.temperature << "," << c.factor << "," << c.duration << "," << c.cost << "," << config.bks[i] << "," << 1.0 * c.cost / config.bks[i] << endl;
+        }
+        out.close();
+    }
+}
+
+/*
+ * Usage: ./SIMULATED_ANNEALING_SOLVER [--parallel-tempering [chains]] [--time-limit ms] [--target-gap g] [--split] [--savings] [--tabu n]
+ *   --time-limit   wall clock limit of each run
+ *   --target-gap   stop as soon as a solution at most g (e.g. 0.05) above the BKS is found
+ *   --split        build the initial solution with the optimal Split of the radial giant tour
+ *   --savings      build the initial solution with the Clarke-Wright savings
+ *   --tabu         reject moves back to one of the last n states visited by the annealing
+ *        ./SIMULATED_ANNEALING_SOLVER --batch <config>   (grid read from a file, see batch_simulated_annealing.cfg)
+ */
+int main(int argc, char** argv)
     {
+        bool tempering = false;
+        int total_chains = max(4, (int) thread::hardware_concurrency());
+        long double time_limit_ms = 0;
+        double target_gap = -1;
+        bool split_initial_tour = false;
+        bool savings_initial = false;
+        int tabu_tenure = 0;
+        for (int a = 1; a < argc; a++) {
+            string arg = argv[a];
+            if (arg == "--batch" && a + 1 < argc) {
+                run_batch(argv[a + 1]);
+                return 0;
+            }
+            else if (arg == "--parallel-tempering") {
+                tempering = true;
+                if (a + 1 < argc && isdigit(argv[a + 1][0])) total_chains = max(2, atoi(argv[++a]));
+            }
+            else if (arg == "--time-limit" && a + 1 < argc) time_limit_ms = atof(argv[++a]);
+            else if (arg == "--target-gap" && a + 1 < argc) target_gap = atof(argv[++a]);
+            else if (arg == "--split") split_initial_tour = true;
+            else if (arg == "--savings") savings_initial = true;
+            else if (arg == "--tabu" && a + 1 < argc) tabu_tenure = max(0, atoi(argv[++a]));
+            else {
+                cerr << "Invalid option: " << arg << endl;
+                cerr << "Usage: ./SIMULATED_ANNEALING_SOLVER [--parallel-tempering [chains]] [--time-limit ms] [--target-gap g] [--split] [--savings] [--tabu n]" << endl;
+                cerr << "       ./SIMULATED_ANNEALING_SOLVER --batch <config>" << endl;
+                return 1;
+            }
+        }
         vector<string> instances = {"instances/X-n101-k25.vrp", "instances/X-n110-k13.vrp", "instances/X-n115-k10.vrp", "instances/X-n204-k19.vrp"};
         for (const string& file: instances) {
-          instance x(file);
-          simulated_annealing annealing_CVRP(x);
+          simulated_annealing annealing_CVRP(load_shared_instance(file));
+          annealing_CVRP.split_initial_tour = split_initial_tour;
+          annealing_CVRP.savings_initial = savings_initial;
+          annealing_CVRP.tabu_tenure = tabu_tenure;
+          if (tempering) annealing_CVRP.test_parallel_tempering(total_chains, time_limit_ms, target_gap);
+          else annealing_CVRP.test_constants(time_limit_ms, target_gap);
         }
 }
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include "solution_hash.h"
+
+uint64_t route_hash( const vector<int>& route, int depot )
+{
+    uint64_t hash = 0;
+    for(int i = 1; i < (int) route.size(); ++i) hash += edge_key(route[i - 1], route[i]);
+    return hash + edge_key(route.back(), depot);
+}
+
+uint64_t solution_hash( const vector< vector<int> >& routes, int depot )
+{
+    uint64_t hash = 0;
+    for(const vector<int>& route : routes) hash += route_hash(route, depot);
+    return hash;
+}
+
+concurrent_hash_set::concurrent_hash_set( int log2_capacity )
+{
+    size_t capacity = (size_t) 1 << log2_capacity;
+    slots.reset( new atomic<uint64_t>[capacity] );
+    for(size_t s = 0; s < capacity; ++s) slots[s].store(0, memory_order_relaxed);
+    mask = capacity - 1;
+}
+
+bool concurrent_hash_set::insert( uint64_t hash )
+{
+    if( hash == 0 ) hash = 1;
+    for(int probe = 0; probe < PROBE_LIMIT; ++probe)
+    {
+        atomic<uint64_t>& slot = slots[(hash + probe) & mask];
+        uint64_t current = slot.load(memory_order_acquire);
+        if( current == hash ) return false;
+        if( current == 0 )
+        {
+            if( slot.compare_exchange_strong(current, hash, memory_order_acq_rel) ) return true;
+            if( current == hash ) return false; // another thread stored the same hash first
+        }
+    }
+    return false;
+}
+
+bool concurrent_hash_set::contains( uint64_t hash ) const
+{
+    if( hash == 0 ) hash = 1;
+    for(int probe = 0; probe < PROBE_LIMIT; ++probe)
+    {
+        uint64_t current = slots[(hash + probe) & mask].load(memory_order_acquire);
+        if( current == hash ) return true;
+        if( current == 0 ) return false;
+    }
+    return false;
+}
+
+void recent_states::reset( int tenure )
+{
+    ring.assign( max(0, tenure), 0 );
+    next = 0;
+}
+
+bool recent_states::contains( uint64_t hash ) const
+{
+    for(const uint64_t state : ring)
+        if( state == hash ) return true;
+    return false;
+}
+
+void recent_states::push( uint64_t hash )
+{
+    if( ring.empty() ) return;
+    ring[next] = hash;
+    next = ( next + 1 == (int) ring.size() ? 0 : next + 1 );
+}
@@ -0,0 +1,69 @@
+#ifndef SOLUTION_HASH_H
+#define SOLUTION_HASH_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+/*
+ * Zobrist hashing of solutions. Every edge {u, v} has a pseudo-random 64 bit key and a solution
+ * hashes to the sum (mod 2^64) of the keys of its edges, depot edges included, so the hash depends
+ * only on the set of routes: not on their order nor on the direction they are driven in.
+ * A move replaces a few edges, so its hash delta is its cost delta with the key in place of the
+ * distance (move_hash_delta in neighborhood_generator.h), O(1) like the cost.
+ * The sum (instead of the usual xor) keeps a route with a single customer, whose depot edge is
+ * there twice, apart from an empty route. key(u, u) = 0, like d(u, u).
+ */
+inline uint64_t edge_key( int u, int v )
+{
+    if( u == v ) return 0;
+    if( u > v ) swap(u, v);
+    uint64_t z = ( (uint64_t) u << 32 | (uint32_t) v ) + 0x9e3779b97f4a7c15ULL; // splitmix64 of the pair
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t route_hash( const vector<int>& route, int depot );
+uint64_t solution_hash( const vector< vector<int> >& routes, int depot );
+
+/*
+ * Fixed size set of hashes shared by threads without locks: open addressing with linear probing
+ * over atomic slots, 0 marks an empty slot (the hash 0 is stored as 1). Nothing is ever removed;
+ * when the PROBE_LIMIT slots from the home one are taken an insertion is dropped, so a full set
+ * only forgets states, it never reports one it has not seen.
+ */
+struct concurrent_hash_set
+{
+    static constexpr int PROBE_LIMIT = 32;
+
+    unique_ptr< atomic<uint64_t>[] > slots;
+    uint64_t mask;
+
+    // 2^log2_capacity slots
+    explicit concurrent_hash_set( int log2_capacity );
+
+    // true if hash was added by this call (false if it was already there or the set is full around it)
+    bool insert( uint64_t hash );
+    bool contains( uint64_t hash ) const;
+};
+
+/*
+ * Tabu list of a search: the hashes of the last `tenure` states visited, in a ring. Looked up by a
+ * linear scan of a contiguous array, which for the short tenures used costs less than a hash table.
+ */
+struct recent_states
+{
+    vector<uint64_t> ring;
+    int next = 0;
+
+    void reset( int tenure );
+    bool contains( uint64_t hash ) const;
+    void push( uint64_t hash );
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include <cmath>
+#include "spatial_index.h"
+
+void spatial_index::build( const vector< pair<int, int> >& points )
+{
+    int n = (int) points.size();
+    cell_start.assign(2, 0);
+    ids.clear();
+    coordinates.clear();
+    columns = rows = cell_size = 1;
+    if( n == 0 ) return;
+    min_x = max_x = points[0].first;
+    min_y = max_y = points[0].second;
+    for(const pair<int, int>& p : points)
+    {
+        min_x = min(min_x, p.first);
+        max_x = max(max_x, p.first);
+        min_y = min(min_y, p.second);
+        max_y = max(max_y, p.second);
+    }
+    double area = (double) max(1, max_x - min_x) * max(1, max_y - min_y);
+    cell_size = max(1, (int) ceil( sqrt( area * POINTS_PER_CELL / n ) ));
+    columns = (max_x - min_x) / cell_size + 1;
+    rows = (max_y - min_y) / cell_size + 1;
+
+    // counting sort of the points by cell
+    cell_start.assign((size_t) columns * rows + 1, 0);
+    for(const pair<int, int>& p : points) cell_start[row_of(p.second) * columns + column_of(p.first) + 1]++;
+    for(size_t c = 1; c < cell_start.size(); ++c) cell_start[c] += cell_start[c - 1];
+    vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+    ids.resize(n);
+    coordinates.resize(n);
+    for(int v = 0; v < n; ++v)
+    {
+        int position = fill[row_of(points[v].second) * columns + column_of(points[v].first)]++;
+        ids[position] = v;
+        coordinates[position] = points[v];
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "distance_matrix.h"
+
+using namespace std;
+
+/*
+ * Static uniform grid over the points of an instance, sized to their bounding box with about
+ * POINTS_PER_CELL points per cell. The points are stored cell by cell (with their coordinates, so
+ * a query never touches the instance), and a query only visits the cells around its center:
+ * O(k) on average for the k nearest points instead of the O(n) scan of all of them.
+ * Distances are euclidean_distance (rounded up, the values of distance_matrix), ties broken by
+ * the smaller index, so the results are exactly those of a sort of every point.
+ */
+struct spatial_index
+{
+    static constexpr int POINTS_PER_CELL = 2;
+
+    int min_x = 0, min_y = 0, max_x = 0, max_y = 0; // bounding box of the points
+    int cell_size = 1, columns = 1, rows = 1;
+    vector<int> cell_start;              // points of cell c: positions cell_start[c] .. cell_start[c + 1] - 1
+    vector<int> ids;                     // index of the point at each position
+    vector< pair<int, int> > coordinates; // its coordinates
+
+    void build( const vector< pair<int, int> >& points );
+
+    int column_of( int x ) const { return min(columns - 1, max(0, (x - min_x) / cell_size)); }
+    int row_of( int y ) const { return min(rows - 1, max(0, (y - min_y) / cell_size)); }
+
+    // The (at most) k points closest to center among those accepted by accept(id), closest first
+    template<class filter>
+    void nearest( const pair<int, int>& center, int k, const filter& accept, vector<int>& result ) const;
+
+    // Every point accepted by accept(id) at distance <= radius of center, in no particular order
+    template<class filter>
+    void within( const pair<int, int>& center, int radius, const filter& accept, vector<int>& result ) const;
+};
+
+template<class filter>
+void spatial_index::nearest( const pair<int, int>& center, int k, const filter& accept, vector<int>& result ) const
+{
+    result.clear();
+    if( k <= 0 || ids.empty() ) return;
+    // max-heap of the best (distance, id) so far, the worst on top
+    thread_local vector< pair<int, int> > best;
+    best.clear();
+    int cx = column_of(center.first), cy = row_of(center.second);
+    int last_ring = max(max(cx, columns - 1 - cx), max(cy, rows - 1 - cy));
+    for(int ring = 0; ring <= last_ring; ++ring)
+    {
+        // the cells of this ring and of the next ones are more than (ring - 1) * cell_size away
+        if( (int) best.size() == k && (long long) (ring - 1) * cell_size >= best.front().first ) break;
+        for(int y = max(0, cy - ring); y <= min(rows - 1, cy + ring); ++y)
+        {
+            bool edge_row = ( y == cy - ring || y == cy + ring );
+            int step = ( edge_row ? 1 : 2 * ring ); // inner rows only have the two cells of the border
+            for(int x = cx - ring; x <= cx + ring; x += max(1, step))
+            {
+                if( x < 0 || x >= columns ) continue;
+                int cell = y * columns + x;
+                for(int p = cell_start[cell]; p < cell_start[cell + 1]; ++p)
+                {
+                    if( !accept(ids[p]) ) continue;
+                    pair<int, int> candidate( euclidean_distance(center, coordinates[p]), ids[p] );
+                    if( (int) best.size() < k )
+                    {
+                        best.push_back(candidate);
+                        push_heap(best.begin(), best.end());
+                    }
+                    else if( candidate < best.front() )
+                    {
+                        pop_heap(best.begin(), best.end());
+                        best.back() = candidate;
+                        push_heap(best.begin(), best.end());
+                    }
+                }
+            }
+        }
+    }
+    sort_heap(best.begin(), best.end());
+    for(const pair<int, int>& entry : best) result.push_back(entry.second);
+}
+
+template<class filter>
+void spatial_index::within( const pair<int, int>& center, int radius, const filter& accept, vector<int>& result ) const
+{
+    result.clear();
+    if( ids.empty() || radius < 0 ) return;
+    int x0 = column_of(center.first - radius), x1 = column_of(center.first + radius);
+    int y0 = row_of(center.second - radius), y1 = row_of(center.second + radius);
+    for(int y = y0; y <= y1; ++y)
+        for(int x = x0; x <= x1; ++x)
+        {
+            int cell = y * columns + x;
+            for(int p = cell_start[cell]; p < cell_start[cell + 1]; ++p)
+                if( euclidean_distance(center, coordinates[p]) <= radius && accept(ids[p]) ) result.push_back(ids[p]);
+        }
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "time_lib.h"
 #include <ctime>
 #include <iostream>
+#include <cmath>
 
 using namespace std;
 
@@ -16,3 +17,51 @@ long double time_in_ms(clock_t start, clock_t end)
     cout << "Total time = " << total_time << " ms" << endl;
     return total_time;
 }
+
+wall_timer::wall_timer() : start(chrono::steady_clock::now()) {}
+
+void wall_timer::reset()
+{
+    start = chrono::steady_clock::now();
+}
+
+long double wall_timer::elapsed_ms() const
+{
+    return chrono::duration<long double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+long double time_in_ms(const wall_timer& timer)
+{
+    long double total_time = timer.elapsed_ms();
+    cout << "Total time = " << total_time << " ms" << endl;
+    return total_time;
+}
+
+deadline::deadline() : active(false) {}
+
+deadline deadline::after_ms(long double ms)
+{
+    deadline d;
+    if( ms > 0 )
+    {
+        d.active = true;
+        d.limit = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>( chrono::duration<long double, milli>(ms) );
+    }
+    return d;
+}
+
+bool deadline::expired() const
+{
+    return active && chrono::steady_clock::now() >= limit;
+}
+
+search_limits::search_limits() : target_cost(-1), check_interval(64), countdown(64), stopped(false) {}
+
+search_limits::search_limits(long double time_limit_ms, int _target_cost, int _check_interval)
+    : time_limit(deadline::after_ms(time_limit_ms)), target_cost(_target_cost),
+      check_interval(_check_interval), countdown(_check_interval), stopped(false) {}
+
+int search_limits::target_from_gap(int bks, double gap)
+{
+    return (int) floor(bks * (1.0 + gap));
+}
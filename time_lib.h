@@ -3,10 +3,70 @@
 
 #include <iostream>
 #include <ctime>
+#include <chrono>
 
 using namespace std;
 
+// CPU time of the whole process (adds up over threads)
 clock_t get_time();
 long double time_in_ms(clock_t start, clock_t end);
 
+// Monotonic stopwatch, measures wall clock time
+struct wall_timer
+{
+    chrono::steady_clock::time_point start;
+
+    wall_timer();
+    void reset();
+    long double elapsed_ms() const;
+};
+
+// Prints and returns the wall clock time measured by timer
+long double time_in_ms(const wall_timer& timer);
+
+// Wall clock deadline based on the monotonic clock; a default constructed deadline never expires
+struct deadline
+{
+    chrono::steady_clock::time_point limit;
+    bool active;
+
+    deadline();
+    static deadline after_ms(long double ms); // ms <= 0 means no deadline
+    bool expired() const;
+};
+
+/*
+ * Stopping rule shared by the solvers: a wall clock deadline and/or a target cost.
+ * should_stop is meant for inner loops: the clock is only read once every check_interval
+ * calls, and once a limit is hit the answer stays true.
+ */
+struct search_limits
+{
+    deadline time_limit;
+    int target_cost;    // stop when a solution with cost <= target_cost is found, -1 = no target
+    int check_interval; // calls to should_stop between two reads of the clock
+    int countdown;
+    bool stopped;
+
+    search_limits();
+    search_limits(long double time_limit_ms, int _target_cost = -1, int _check_interval = 64);
+
+    // Target cost for a gap to the BKS, e.g. gap = 0.05 stops at 5% above it
+    static int target_from_gap(int bks, double gap);
+
+    bool reached_target(int best_cost) const { return target_cost >= 0 && best_cost <= target_cost; }
+
+    inline bool should_stop(int best_cost)
+    {
+        if( stopped ) return true;
+        if( reached_target(best_cost) ) return stopped = true;
+        if( time_limit.active && --countdown <= 0 )
+        {
+            countdown = check_interval;
+            stopped = time_limit.expired();
+        }
+        return stopped;
+    }
+};
+
 #endif